@@ -0,0 +1,130 @@
+#include "ann.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QtAlgorithms>
+#include <random>
+
+// minhash signatures: a random hash per (pixel, hash function) and, for
+// every function, the minimum over the glyph's set pixels
+static void minhash(const quint64 *row, int words,
+                    const QVector<quint32> &pixelHash, int hashes,
+                    quint32 *sig) {
+    for (int h = 0; h < hashes; h++)
+        sig[h] = 0xffffffffu;
+    for (int w = 0; w < words; w++) {
+        quint64 v = row[w];
+        while (v) {
+            int pixel = w * 64 + qCountTrailingZeroBits(v);
+            const quint32 *ph = pixelHash.constData() + pixel * hashes;
+            for (int h = 0; h < hashes; h++)
+                if (ph[h] < sig[h])
+                    sig[h] = ph[h];
+            v &= v - 1;
+        }
+    }
+}
+
+static quint64 band_key(const quint32 *sig, int rows) {
+    quint64 key = 14695981039346656037ull; // fnv-1a
+    for (int r = 0; r < rows; r++) {
+        key ^= sig[r];
+        key *= 1099511628211ull;
+    }
+    return key;
+}
+
+static int intersection(const quint64 *a, const quint64 *b, int words) {
+    int n11 = 0;
+    for (int k = 0; k < words; k++)
+        n11 += qPopulationCount(a[k] & b[k]);
+    return n11;
+}
+
+QVector<int> nearestBinaryLsh(const BitMatrix &testM, const QVector<int> &test,
+                              const BitMatrix &trainM,
+                              const QVector<int> &train, Metric metric,
+                              const LshParams &params, KernelStats *stats,
+                              LshStats *lsh) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int hashes = params.bands * params.rows;
+    int words = trainM.words;
+
+    std::mt19937 rng(params.seed);
+    QVector<quint32> pixelHash(trainM.bits * hashes);
+    for (int i = 0; i < pixelHash.size(); i++)
+        pixelHash[i] = rng();
+
+    // one bucket table per band over the train glyphs
+    QVector<QHash<quint64, QVector<int>>> tables(params.bands);
+    QVector<quint32> sig(hashes);
+    for (int j = 0; j < train.size(); j++) {
+        minhash(trainM.row(train[j]), words, pixelHash, hashes, sig.data());
+        for (int b = 0; b < params.bands; b++)
+            tables[b][band_key(sig.constData() + b * params.rows, params.rows)]
+                .push_back(j);
+    }
+    qint64 built = timer.nsecsElapsed();
+
+    QVector<int> best(test.size(), -1);
+    QVector<int> seen(train.size(), -1);
+    QVector<int> candidates;
+    qint64 reranked = 0;
+    qint64 rerankNsecs = 0;
+    int fallbacks = 0;
+
+    for (int i = 0; i < test.size(); i++) {
+        const quint64 *t = testM.row(test[i]);
+        minhash(t, words, pixelHash, hashes, sig.data());
+
+        candidates.clear();
+        for (int b = 0; b < params.bands; b++) {
+            auto bucket = tables[b].constFind(
+                band_key(sig.constData() + b * params.rows, params.rows));
+            if (bucket == tables[b].constEnd())
+                continue;
+            for (int j : *bucket)
+                if (seen[j] != i) {
+                    seen[j] = i;
+                    candidates.push_back(j);
+                }
+        }
+
+        // nothing collided: search the whole train set
+        if (candidates.isEmpty()) {
+            fallbacks++;
+            for (int j = 0; j < train.size(); j++)
+                candidates.push_back(j);
+        }
+        reranked += candidates.size();
+
+        // exact rerank; ties keep the first train glyph like the full scan.
+        // only this part is timed as the distance kernel
+        qint64 rerankStart = timer.nsecsElapsed();
+        double bestScore = -1000000;
+        int onesTest = testM.ones[test[i]];
+        for (int j : candidates) {
+            double score = binarySimilarity(
+                intersection(t, trainM.row(train[j]), words), onesTest,
+                trainM.ones[train[j]], trainM.bits, metric);
+            if (score > bestScore || (score == bestScore && j < best[i])) {
+                bestScore = score;
+                best[i] = j;
+            }
+        }
+        rerankNsecs += timer.nsecsElapsed() - rerankStart;
+    }
+
+    if (stats) {
+        stats->ops += reranked * words;
+        stats->nsecs += rerankNsecs;
+    }
+    if (lsh) {
+        lsh->buildNsecs += built;
+        lsh->queryNsecs += timer.nsecsElapsed() - built;
+        lsh->candidates += reranked;
+        lsh->fallbacks += fallbacks;
+    }
+    return best;
+}
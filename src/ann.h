@@ -0,0 +1,35 @@
+#ifndef ANN_H
+#define ANN_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include "distance.h"
+
+// minhash lsh: each band hashes `rows` minhashes of a glyph's set pixels;
+// train glyphs sharing any band bucket with a test glyph are its candidates.
+// more bands raise recall, more rows per band shrink the candidate sets
+struct LshParams {
+    int bands = 16;
+    int rows = 3;
+    unsigned seed = 2018;
+};
+
+struct LshStats {
+    qint64 buildNsecs = 0; // signatures and tables of the train glyphs
+    qint64 queryNsecs = 0; // lookups and exact reranking
+    qint64 candidates = 0; // reranked candidates over all queries
+    int fallbacks = 0;     // queries without candidates (searched exactly)
+};
+
+// like nearestBinary, but every test glyph is only compared (exactly) with
+// its lsh candidates; stats count the exact reranking only, the hashing is
+// in the build and query times of lsh
+QVector<int> nearestBinaryLsh(const BitMatrix &testM, const QVector<int> &test,
+                              const BitMatrix &trainM,
+                              const QVector<int> &train, Metric metric,
+                              const LshParams &params,
+                              KernelStats *stats = nullptr,
+                              LshStats *lsh = nullptr);
+
+#endif // ANN_H
@@ -0,0 +1,55 @@
+#include "arena.h"
+#include <new>
+
+Arena::Arena(const QString &name, size_t blockSize)
+    : arenaName(name), blockSize(blockSize) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+    // find room in the current or a later (reused) block
+    while (current < blocks.size()) {
+        Block &b = blocks[current];
+        size_t start = (offset + align - 1) / align * align;
+        if (start + bytes <= b.size) {
+            used += start + bytes - offset;
+            if (used > peak)
+                peak = used;
+            offset = start + bytes;
+            return b.data + start;
+        }
+        current++;
+        offset = 0;
+    }
+
+    // new blocks come from operator new, so they satisfy any fundamental
+    // alignment; oversized requests get a block of their own
+    size_t size = bytes > blockSize ? bytes : blockSize;
+    Block b = {static_cast<char *>(::operator new(size)), size};
+    blocks.push_back(b);
+    reserved += size;
+
+    current = blocks.size() - 1;
+    offset = bytes;
+    used += bytes;
+    if (used > peak)
+        peak = used;
+    return b.data;
+}
+
+void Arena::reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+void Arena::release() {
+    for (int i = 0; i < blocks.size(); i++)
+        ::operator delete(blocks[i].data);
+    blocks.clear();
+    blocks.squeeze();
+    reserved = 0;
+    reset();
+}
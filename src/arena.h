@@ -0,0 +1,50 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <cstddef>
+
+// bump allocator owning the data of a loaded dataset; every allocation is
+// dropped at once by reset(), which keeps the blocks for the next load
+class Arena {
+  public:
+    explicit Arena(const QString &name, size_t blockSize = 1 << 20);
+    ~Arena();
+
+    // uninitialized storage for n objects of a trivially copyable type
+    template <class T> T *allocate(int n) {
+        return static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+    }
+    void *allocate(size_t bytes, size_t align);
+
+    void reset();   // O(1), memory stays reserved
+    void release(); // reset and give the blocks back to the system
+    void resetPeak() { peak = used; } // e.g. to measure a single run
+
+    QString name() const { return arenaName; }
+    qint64 usedBytes() const { return used; }
+    qint64 peakBytes() const { return peak; }
+    qint64 reservedBytes() const { return reserved; }
+
+  private:
+    Q_DISABLE_COPY(Arena)
+
+    struct Block {
+        char *data;
+        size_t size;
+    };
+
+    QString arenaName;
+    size_t blockSize;
+    QVector<Block> blocks;
+    int current = 0;   // block being filled
+    size_t offset = 0; // first free byte of the current block
+
+    qint64 used = 0;
+    qint64 peak = 0;
+    qint64 reserved = 0;
+};
+
+#endif // ARENA_H
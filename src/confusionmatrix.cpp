@@ -0,0 +1,134 @@
+#include "confusionmatrix.h"
+#include <QFile>
+#include <QTextStream>
+
+// counters
+
+void ConfusionCounts::resize(int numClasses) {
+    n_classes = numClasses;
+    cells.reset(numClasses ? new QAtomicInt[numClasses * numClasses]
+                           : nullptr);
+}
+
+void ConfusionCounts::clear() {
+    for (int i = 0; i < n_classes * n_classes; i++)
+        cells[i].store(0);
+}
+
+int ConfusionCounts::predictedTotal(int c) const {
+    int total = 0;
+    for (int a = 0; a < n_classes; a++)
+        total += count(c, a);
+    return total;
+}
+
+int ConfusionCounts::actualTotal(int c) const {
+    int total = 0;
+    for (int p = 0; p < n_classes; p++)
+        total += count(p, c);
+    return total;
+}
+
+double ConfusionCounts::precision(int c) const {
+    int total = predictedTotal(c);
+    return total ? double(count(c, c)) / total : 0;
+}
+
+double ConfusionCounts::recall(int c) const {
+    int total = actualTotal(c);
+    return total ? double(count(c, c)) / total : 0;
+}
+
+double ConfusionCounts::f1(int c) const {
+    double p = precision(c);
+    double r = recall(c);
+    return p + r ? 2 * p * r / (p + r) : 0;
+}
+
+bool ConfusionCounts::exportCsv(const QString &path,
+                                const QStringList &names) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "\"predicted \\ actual\"";
+    for (int a = 0; a < n_classes; a++)
+        out << ",\"" << names.value(a) << "\"";
+    out << ",precision,recall,f1\n";
+
+    for (int p = 0; p < n_classes; p++) {
+        out << "\"" << names.value(p) << "\"";
+        for (int a = 0; a < n_classes; a++)
+            out << "," << count(p, a);
+        out << "," << precision(p) << "," << recall(p) << "," << f1(p)
+            << "\n";
+    }
+    return true;
+}
+
+// model
+
+ConfusionMatrixModel::ConfusionMatrixModel(ConfusionCounts *counts,
+                                           QObject *parent)
+    : QAbstractTableModel(parent), counts(counts) {}
+
+void ConfusionMatrixModel::reset(const QStringList &classNames) {
+    beginResetModel();
+    counts->resize(classNames.size());
+    names = classNames;
+    endResetModel();
+}
+
+void ConfusionMatrixModel::refresh() {
+    if (!rowCount() || !columnCount())
+        return;
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+int ConfusionMatrixModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : counts->classes();
+}
+
+int ConfusionMatrixModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() || !counts->classes() ? 0 : counts->classes() + 3;
+}
+
+QVariant ConfusionMatrixModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    int i = index.row();
+    int j = index.column();
+    int n = counts->classes();
+
+    if (j < n) {
+        int v = counts->count(i, j);
+        if (i == j)
+            return QString::number(v) + "/" +
+                   QString::number(counts->actualTotal(i));
+        return v ? QVariant(v) : QVariant();
+    }
+    if (j == n)
+        return QString::number(counts->precision(i), 'f', 3);
+    if (j == n + 1)
+        return QString::number(counts->recall(i), 'f', 3);
+    return QString::number(counts->f1(i), 'f', 3);
+}
+
+QVariant ConfusionMatrixModel::headerData(int section,
+                                          Qt::Orientation orientation,
+                                          int role) const {
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    int n = counts->classes();
+    if (orientation == Qt::Vertical || section < n)
+        return names.value(section);
+    if (section == n)
+        return QString("Precision");
+    if (section == n + 1)
+        return QString("Recall");
+    return QString("F1");
+}
@@ -0,0 +1,66 @@
+#ifndef CONFUSIONMATRIX_H
+#define CONFUSIONMATRIX_H
+
+#include <QAbstractTableModel>
+#include <QAtomicInt>
+#include <QStringList>
+#include <memory>
+
+// flat [predicted][actual] counters; add() may be called from several
+// threads at once (e.g. by cross-validation folds)
+class ConfusionCounts {
+  public:
+    void resize(int numClasses); // also zeroes every counter
+    void clear();
+
+    void add(int predicted, int actual, int n = 1) {
+        Q_ASSERT(predicted >= 0 && predicted < n_classes);
+        Q_ASSERT(actual >= 0 && actual < n_classes);
+        cells[predicted * n_classes + actual].fetchAndAddRelaxed(n);
+    }
+    int count(int predicted, int actual) const {
+        return cells[predicted * n_classes + actual].load();
+    }
+    int classes() const { return n_classes; }
+
+    // per-class statistics, computed from the counters when asked for
+    int predictedTotal(int c) const; // row sum
+    int actualTotal(int c) const;    // column sum (tested samples of c)
+    double precision(int c) const;
+    double recall(int c) const;
+    double f1(int c) const;
+
+    bool exportCsv(const QString &path, const QStringList &names) const;
+
+  private:
+    int n_classes = 0;
+    std::unique_ptr<QAtomicInt[]> cells;
+};
+
+// read-only table over a ConfusionCounts: rows are predicted classes,
+// columns actual classes followed by the precision, recall and f1 of the
+// row's class
+class ConfusionMatrixModel : public QAbstractTableModel {
+    Q_OBJECT
+
+  public:
+    explicit ConfusionMatrixModel(ConfusionCounts *counts,
+                                  QObject *parent = nullptr);
+
+    // resizes (and zeroes) the counters inside a model reset
+    void reset(const QStringList &names);
+    void refresh(); // after a run, from the gui thread
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index,
+                  int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+  private:
+    ConfusionCounts *counts;
+    QStringList names;
+};
+
+#endif // CONFUSIONMATRIX_H
@@ -0,0 +1,317 @@
+#include "distance.h"
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <limits>
+
+// tile sizes of the all-pairs kernels
+//
+// l1: a 4x4 register tile walks KC dims of 4 test and 4 train rows, so
+// 8 * KC doubles (16KB) stay in L1, while a block of NC train rows
+// (NC * KC doubles, 256KB) stays in L2 as MC test rows stream against it
+static const int L1_KC = 256;
+static const int L1_NC = 128;
+static const int L1_MC = 64;
+
+// binary: a 50x50 glyph is only 40 words, so whole rows are tiled and a
+// block of NC train glyphs (80KB) stays in L2
+static const int BIN_NC = 256;
+static const int BIN_MC = 64;
+
+static const int MR = 4; // register tile rows (test)
+static const int NR = 4; // register tile columns (train)
+
+static int round_up(int n, int m) {
+    return (n + m - 1) / m * m;
+}
+
+// packing
+
+BitMatrix packGlyphs(const QVector<Glyph> &images) {
+    BitMatrix m;
+    m.rows = images.size();
+    if (!m.rows)
+        return m;
+    int height = images[0].height;
+    int width = images[0].width;
+    m.bits = width * height;
+    m.words = (m.bits + 63) / 64;
+    m.data.fill(0, m.rows * m.words);
+    m.ones.fill(0, m.rows);
+
+    for (int i = 0; i < m.rows; i++) {
+        quint64 *row = m.data.data() + i * m.words;
+        int bit = 0;
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++, bit++)
+                if (images[i][y][x]) {
+                    row[bit / 64] |= quint64(1) << (bit % 64);
+                    m.ones[i]++;
+                }
+    }
+    return m;
+}
+
+double binarySimilarity(int n11, int onesTest, int onesTrain, int bits,
+                        Metric metric) {
+    double a = n11;                // n11
+    double b = onesTest - n11;     // n10
+    double c = onesTrain - n11;    // n01
+    double d = bits - n11 - b - c; // n00
+    if (metric == Metric::Jaccard)
+        return a / (a + b + c);
+    return ((a * d) - (b * c)) / ((a * d) + (b * c));
+}
+
+// l1 kernel
+
+// accumulates |a - b| over dims [k0, k1) into a 4x4 tile of c; every
+// pair is summed in dim order, so results match a plain pairwise loop
+static void l1_tile(const double *const *a, const double *const *b, int k0,
+                    int k1, double *c, int ldc) {
+    double acc[MR][NR];
+    for (int r = 0; r < MR; r++)
+        for (int s = 0; s < NR; s++)
+            acc[r][s] = c[r * ldc + s];
+
+    for (int k = k0; k < k1; k++) {
+        double av[MR], bv[NR];
+        for (int r = 0; r < MR; r++)
+            av[r] = a[r][k];
+        for (int s = 0; s < NR; s++)
+            bv[s] = b[s][k];
+        for (int r = 0; r < MR; r++)
+            for (int s = 0; s < NR; s++) {
+                double td = av[r] - bv[s];
+                acc[r][s] += td < 0 ? -td : td;
+            }
+    }
+
+    for (int r = 0; r < MR; r++)
+        for (int s = 0; s < NR; s++)
+            c[r * ldc + s] = acc[r][s];
+}
+
+// inserts train row j into a sorted top-k list; equal distances go after
+// the ones already there, so earlier train rows win ties
+static void insert_top_k(double *dist, int *idx, int k, double d, int j) {
+    if (!(d < dist[k - 1]))
+        return;
+    int p = k - 1;
+    while (p > 0 && d < dist[p - 1]) {
+        dist[p] = dist[p - 1];
+        idx[p] = idx[p - 1];
+        p--;
+    }
+    dist[p] = d;
+    idx[p] = j;
+}
+
+QVector<int> nearestL1(const QVector<const double *> &test,
+                       const QVector<const double *> &train, int dim,
+                       KernelStats *stats) {
+    return nearestL1K(test, train, dim, 1, stats);
+}
+
+QVector<int> nearestL1K(const QVector<const double *> &test,
+                        const QVector<const double *> &train, int dim, int k,
+                        KernelStats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int nTest = test.size();
+    int nTrain = train.size();
+    QVector<int> best(nTest * k, -1);
+    QVector<double> bestDist(nTest * k, std::numeric_limits<double>::max());
+
+    // edge tiles repeat the last row so the kernel always runs 4x4
+    QVector<const double *> a(round_up(L1_MC, MR)), b(round_up(L1_NC, NR));
+    QVector<double> c(a.size() * b.size());
+    int ldc = b.size();
+
+    for (int i0 = 0; i0 < nTest; i0 += L1_MC) {
+        int mc = std::min(L1_MC, nTest - i0);
+        for (int i = 0; i < a.size(); i++)
+            a[i] = test[i0 + std::min(i, mc - 1)];
+
+        for (int j0 = 0; j0 < nTrain; j0 += L1_NC) {
+            int nc = std::min(L1_NC, nTrain - j0);
+            for (int j = 0; j < b.size(); j++)
+                b[j] = train[j0 + std::min(j, nc - 1)];
+
+            std::fill(c.begin(), c.end(), 0.0);
+            for (int k0 = 0; k0 < dim; k0 += L1_KC) {
+                int k1 = std::min(dim, k0 + L1_KC);
+                for (int i = 0; i < mc; i += MR)
+                    for (int j = 0; j < nc; j += NR)
+                        l1_tile(a.constData() + i, b.constData() + j, k0, k1,
+                                c.data() + i * ldc + j, ldc);
+            }
+
+            // train rows are visited in order, so ties keep the first one
+            for (int i = 0; i < mc; i++) {
+                double *dist = bestDist.data() + (i0 + i) * k;
+                int *idx = best.data() + (i0 + i) * k;
+                for (int j = 0; j < nc; j++)
+                    insert_top_k(dist, idx, k, c[i * ldc + j], j0 + j);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->ops += qint64(3) * nTest * nTrain * dim; // sub, abs, add
+        stats->nsecs += timer.nsecsElapsed();
+    }
+    return best;
+}
+
+// binary kernel
+
+// intersection counts of a 4x4 tile: a small bit-matrix product
+static void popcount_tile(const quint64 *const *a, const quint64 *const *b,
+                          int words, int *c, int ldc) {
+    int acc[MR][NR] = {};
+    for (int k = 0; k < words; k++) {
+        quint64 av[MR], bv[NR];
+        for (int r = 0; r < MR; r++)
+            av[r] = a[r][k];
+        for (int s = 0; s < NR; s++)
+            bv[s] = b[s][k];
+        for (int r = 0; r < MR; r++)
+            for (int s = 0; s < NR; s++)
+                acc[r][s] += qPopulationCount(av[r] & bv[s]);
+    }
+
+    for (int r = 0; r < MR; r++)
+        for (int s = 0; s < NR; s++)
+            c[r * ldc + s] = acc[r][s];
+}
+
+QVector<int> nearestBinary(const BitMatrix &testM, const QVector<int> &test,
+                           const BitMatrix &trainM, const QVector<int> &train,
+                           Metric metric, KernelStats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int nTest = test.size();
+    int nTrain = train.size();
+    QVector<int> best(nTest, -1);
+    QVector<double> bestScore(nTest, -1000000);
+
+    QVector<const quint64 *> a(round_up(BIN_MC, MR)), b(round_up(BIN_NC, NR));
+    QVector<int> c(a.size() * b.size());
+    int ldc = b.size();
+
+    for (int i0 = 0; i0 < nTest; i0 += BIN_MC) {
+        int mc = std::min(BIN_MC, nTest - i0);
+        for (int i = 0; i < a.size(); i++)
+            a[i] = testM.row(test[i0 + std::min(i, mc - 1)]);
+
+        for (int j0 = 0; j0 < nTrain; j0 += BIN_NC) {
+            int nc = std::min(BIN_NC, nTrain - j0);
+            for (int j = 0; j < b.size(); j++)
+                b[j] = trainM.row(train[j0 + std::min(j, nc - 1)]);
+
+            for (int i = 0; i < mc; i += MR)
+                for (int j = 0; j < nc; j += NR)
+                    popcount_tile(a.constData() + i, b.constData() + j,
+                                  trainM.words, c.data() + i * ldc + j, ldc);
+
+            for (int i = 0; i < mc; i++) {
+                int onesTest = testM.ones[test[i0 + i]];
+                for (int j = 0; j < nc; j++) {
+                    double score = binarySimilarity(
+                        c[i * ldc + j], onesTest, trainM.ones[train[j0 + j]],
+                        trainM.bits, metric);
+                    if (score > bestScore[i0 + i]) {
+                        bestScore[i0 + i] = score;
+                        best[i0 + i] = j0 + j;
+                    }
+                }
+            }
+        }
+    }
+
+    if (stats) {
+        stats->ops += qint64(nTest) * nTrain * trainM.words;
+        stats->nsecs += timer.nsecsElapsed();
+    }
+    return best;
+}
+
+// reranking of candidate lists
+
+QVector<int> rerankL1(const QVector<const double *> &test,
+                      const QVector<const double *> &train, int dim,
+                      const QVector<int> &candidates, int k,
+                      KernelStats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<int> best(test.size(), -1);
+    qint64 pairs = 0;
+    for (int i = 0; i < test.size(); i++) {
+        double bestDist = std::numeric_limits<double>::max();
+        for (int m = 0; m < k; m++) {
+            int j = candidates[i * k + m];
+            if (j < 0)
+                continue;
+            double distance = 0.0;
+            for (int d = 0; d < dim; d++) {
+                double td = train[j][d] - test[i][d];
+                distance += td < 0 ? -td : td;
+            }
+            pairs++;
+            // candidates come in coarse order; ties go to the first train row
+            if (distance < bestDist ||
+                (distance == bestDist && j < best[i])) {
+                bestDist = distance;
+                best[i] = j;
+            }
+        }
+    }
+
+    if (stats) {
+        stats->ops += 3 * pairs * dim;
+        stats->nsecs += timer.nsecsElapsed();
+    }
+    return best;
+}
+
+QVector<int> rerankBinary(const BitMatrix &testM, const QVector<int> &test,
+                          const BitMatrix &trainM, const QVector<int> &train,
+                          const QVector<int> &candidates, int k,
+                          Metric metric, KernelStats *stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<int> best(test.size(), -1);
+    qint64 pairs = 0;
+    for (int i = 0; i < test.size(); i++) {
+        const quint64 *a = testM.row(test[i]);
+        double bestScore = -1000000;
+        for (int m = 0; m < k; m++) {
+            int j = candidates[i * k + m];
+            if (j < 0)
+                continue;
+            const quint64 *b = trainM.row(train[j]);
+            int n11 = 0;
+            for (int w = 0; w < trainM.words; w++)
+                n11 += qPopulationCount(a[w] & b[w]);
+            double score =
+                binarySimilarity(n11, testM.ones[test[i]],
+                                 trainM.ones[train[j]], trainM.bits, metric);
+            pairs++;
+            if (score > bestScore || (score == bestScore && j < best[i])) {
+                bestScore = score;
+                best[i] = j;
+            }
+        }
+    }
+
+    if (stats) {
+        stats->ops += pairs * trainM.words;
+        stats->nsecs += timer.nsecsElapsed();
+    }
+    return best;
+}
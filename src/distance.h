@@ -0,0 +1,64 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include "glyph.h"
+
+enum class Metric { L1, Jaccard, Yule };
+
+// work done by a distance kernel, used to report its throughput
+struct KernelStats {
+    qint64 ops = 0; // flops (l1) or popcounts (jaccard/yule)
+    qint64 nsecs = 0;
+
+    double gigaOpsPerSec() const { return nsecs ? double(ops) / nsecs : 0; }
+};
+
+// binary glyphs packed 64 pixels per word, one row per glyph
+struct BitMatrix {
+    int rows = 0;
+    int words = 0; // words per row
+    int bits = 0;  // pixels per row
+    QVector<quint64> data;
+    QVector<int> ones; // set pixels of every row
+
+    const quint64 *row(int i) const { return data.constData() + i * words; }
+};
+
+BitMatrix packGlyphs(const QVector<Glyph> &images);
+
+// jaccard or yule similarity from the intersection count of two glyphs
+double binarySimilarity(int n11, int onesTest, int onesTrain, int bits,
+                        Metric metric);
+
+// index (into train) of the l1-nearest train row of every test row
+QVector<int> nearestL1(const QVector<const double *> &test,
+                       const QVector<const double *> &train, int dim,
+                       KernelStats *stats = nullptr);
+
+// indices (into train) of the k l1-nearest train rows of every test row,
+// nearest first: row i of the result is [i * k, (i + 1) * k), padded with -1
+QVector<int> nearestL1K(const QVector<const double *> &test,
+                        const QVector<const double *> &train, int dim, int k,
+                        KernelStats *stats = nullptr);
+
+// index (into train) of the most similar train row of every test row,
+// test and train being row indices into their bit matrices
+QVector<int> nearestBinary(const BitMatrix &testM, const QVector<int> &test,
+                           const BitMatrix &trainM, const QVector<int> &train,
+                           Metric metric, KernelStats *stats = nullptr);
+
+// nearest of the k candidates (indices into train, -1 for none) that
+// nearestL1K picked for every test row, rescored with another distance
+QVector<int> rerankL1(const QVector<const double *> &test,
+                      const QVector<const double *> &train, int dim,
+                      const QVector<int> &candidates, int k,
+                      KernelStats *stats = nullptr);
+QVector<int> rerankBinary(const BitMatrix &testM, const QVector<int> &test,
+                          const BitMatrix &trainM, const QVector<int> &train,
+                          const QVector<int> &candidates, int k,
+                          Metric metric, KernelStats *stats = nullptr);
+
+#endif // DISTANCE_H
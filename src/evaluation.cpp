@@ -0,0 +1,235 @@
+#include "evaluation.h"
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <random>
+
+// fold generators
+
+static QVector<QVector<int>> group_by_class(const QVector<int> &labels,
+                                            int numClasses) {
+    QVector<QVector<int>> byClass(numClasses);
+    for (int i = 0; i < labels.size(); i++)
+        byClass[labels[i]].push_back(i);
+    return byClass;
+}
+
+QVector<Fold> kFolds(const QVector<int> &labels, int numClasses, int k,
+                     unsigned seed) {
+    std::mt19937 rng(seed);
+    QVector<QVector<int>> byClass = group_by_class(labels, numClasses);
+
+    // shuffle every class and deal its members round-robin to the folds,
+    // carrying the dealer position over so fold sizes stay balanced
+    QVector<int> foldOf(labels.size());
+    int next = 0;
+    for (int c = 0; c < byClass.size(); c++) {
+        std::shuffle(byClass[c].begin(), byClass[c].end(), rng);
+        for (int idx : byClass[c]) {
+            foldOf[idx] = next;
+            next = (next + 1) % k;
+        }
+    }
+
+    QVector<Fold> folds(k);
+    for (int i = 0; i < labels.size(); i++)
+        for (int f = 0; f < k; f++) {
+            if (foldOf[i] == f)
+                folds[f].test.push_back(i);
+            else
+                folds[f].train.push_back(i);
+        }
+    return folds;
+}
+
+QVector<Fold> repeatedSplits(const QVector<int> &labels, int numClasses,
+                             int repeats, double testFraction, unsigned seed) {
+    std::mt19937 rng(seed);
+    QVector<QVector<int>> byClass = group_by_class(labels, numClasses);
+
+    QVector<Fold> folds(repeats);
+    QVector<bool> isTest(labels.size());
+    for (int r = 0; r < repeats; r++) {
+        isTest.fill(false);
+        for (int c = 0; c < byClass.size(); c++) {
+            std::shuffle(byClass[c].begin(), byClass[c].end(), rng);
+            int n = static_cast<int>(byClass[c].size() * testFraction + 0.5);
+            for (int m = 0; m < n; m++)
+                isTest[byClass[c][m]] = true;
+        }
+        for (int i = 0; i < labels.size(); i++) {
+            if (isTest[i])
+                folds[r].test.push_back(i);
+            else
+                folds[r].train.push_back(i);
+        }
+    }
+    return folds;
+}
+
+// scoring
+
+int scoreNearest(const QVector<int> &nearest, const int *trainLabels,
+                 const int *testLabels, ConfusionCounts *confusion,
+                 QVector<int> *correctByClass) {
+    int correct = 0;
+    for (int k = 0; k < nearest.size(); k++) {
+        int cclass = nearest[k] < 0 ? -4 : trainLabels[nearest[k]];
+        int actual = testLabels[k];
+        if (cclass == actual) {
+            correct++;
+            if (correctByClass)
+                (*correctByClass)[actual]++;
+        }
+        if (cclass >= 0 && confusion)
+            confusion->add(cclass, actual);
+    }
+    return correct;
+}
+
+// fold evaluation
+
+// the rows folds index into: feature rows (l1) or packed glyphs
+struct FoldData {
+    const FeatureMatrix *features;
+    const BitMatrix *packed;
+    const int *labels;
+    Metric metric;
+    int numClasses;
+    ConfusionCounts *total;
+};
+
+static FoldResult evaluate_fold(const FoldData &d, const Fold &fold) {
+    FoldResult result;
+    result.correct.fill(0, d.numClasses);
+    if (fold.test.isEmpty())
+        return result;
+
+    QVector<int> nearest;
+    if (d.metric == Metric::L1) {
+        QVector<const double *> test(fold.test.size());
+        QVector<const double *> train(fold.train.size());
+        for (int k = 0; k < test.size(); k++)
+            test[k] = d.features->row(fold.test[k]);
+        for (int i = 0; i < train.size(); i++)
+            train[i] = d.features->row(fold.train[i]);
+        nearest = nearestL1(test, train, d.features->cols, &result.kernel);
+    } else
+        nearest = nearestBinary(*d.packed, fold.test, *d.packed, fold.train,
+                                d.metric, &result.kernel);
+
+    QVector<int> trainLabels(fold.train.size());
+    QVector<int> testLabels(fold.test.size());
+    for (int i = 0; i < trainLabels.size(); i++)
+        trainLabels[i] = d.labels[fold.train[i]];
+    for (int k = 0; k < testLabels.size(); k++)
+        testLabels[k] = d.labels[fold.test[k]];
+    int correct = scoreNearest(nearest, trainLabels.constData(),
+                               testLabels.constData(), d.total,
+                               &result.correct);
+    result.accuracy = ((double)correct * 100) / fold.test.size();
+    return result;
+}
+
+FoldResult evaluateFold(const FeatureMatrix &m, const Fold &fold,
+                        int numClasses, ConfusionCounts *total) {
+    FoldData d = {&m, nullptr, m.labels, Metric::L1, numClasses, total};
+    return evaluate_fold(d, fold);
+}
+
+FoldResult evaluateFold(const BitMatrix &packed, const int *labels,
+                        const Fold &fold, Metric metric, int numClasses,
+                        ConfusionCounts *total) {
+    FoldData d = {nullptr, &packed, labels, metric, numClasses, total};
+    return evaluate_fold(d, fold);
+}
+
+struct FoldTask {
+    const FoldData *data;
+    const Fold *fold;
+    FoldResult result;
+};
+
+static void run_fold(FoldTask &task) {
+    task.result = evaluate_fold(*task.data, *task.fold);
+}
+
+static double sample_variance(double sum, double sumSq, int n) {
+    if (n < 2)
+        return 0;
+    double mean = sum / n;
+    return std::max(0.0, (sumSq - n * mean * mean) / (n - 1));
+}
+
+static EvaluationResult evaluate_folds(const FoldData &d,
+                                       const QVector<Fold> &folds) {
+    int numClasses = d.numClasses;
+
+    // folds only hold indices into the shared rows, so they can be
+    // evaluated concurrently without copying any features
+    QVector<FoldTask> tasks(folds.size());
+    for (int f = 0; f < folds.size(); f++)
+        tasks[f] = {&d, &folds[f], FoldResult()};
+    QElapsedTimer timer;
+    timer.start();
+    QtConcurrent::blockingMap(tasks, run_fold);
+
+    EvaluationResult res;
+    res.folds = folds.size();
+    res.kernel.nsecs = timer.nsecsElapsed();
+    QVector<double> classSum(numClasses, 0), classSumSq(numClasses, 0);
+    QVector<int> classFolds(numClasses, 0);
+    QVector<int> tested(numClasses);
+    double sum = 0, sumSq = 0;
+
+    for (const FoldTask &task : tasks) {
+        const FoldResult &fr = task.result;
+        res.foldAccuracy.push_back(fr.accuracy);
+        sum += fr.accuracy;
+        sumSq += fr.accuracy * fr.accuracy;
+        res.kernel.ops += fr.kernel.ops;
+        res.kernelCpuNsecs += fr.kernel.nsecs;
+
+        // per-class accuracy (recall) of this fold, over all of its test
+        // samples of the class (found a neighbour or not)
+        tested.fill(0);
+        for (int idx : task.fold->test)
+            tested[d.labels[idx]]++;
+        for (int c = 0; c < numClasses; c++) {
+            if (!tested[c])
+                continue;
+            double acc = fr.correct[c] * 100.0 / tested[c];
+            classSum[c] += acc;
+            classSumSq[c] += acc * acc;
+            classFolds[c]++;
+        }
+    }
+
+    if (res.folds) {
+        res.meanAccuracy = sum / res.folds;
+        res.varAccuracy = sample_variance(sum, sumSq, res.folds);
+    }
+    res.meanClassAccuracy.fill(0, numClasses);
+    res.varClassAccuracy.fill(0, numClasses);
+    for (int c = 0; c < numClasses; c++) {
+        if (!classFolds[c])
+            continue;
+        res.meanClassAccuracy[c] = classSum[c] / classFolds[c];
+        res.varClassAccuracy[c] =
+            sample_variance(classSum[c], classSumSq[c], classFolds[c]);
+    }
+    return res;
+}
+
+EvaluationResult evaluate(const FeatureMatrix &m, const QVector<Fold> &folds,
+                          int numClasses, ConfusionCounts *total) {
+    FoldData d = {&m, nullptr, m.labels, Metric::L1, numClasses, total};
+    return evaluate_folds(d, folds);
+}
+
+EvaluationResult evaluate(const BitMatrix &packed, const int *labels,
+                          const QVector<Fold> &folds, Metric metric,
+                          int numClasses, ConfusionCounts *total) {
+    FoldData d = {nullptr, &packed, labels, metric, numClasses, total};
+    return evaluate_folds(d, folds);
+}
@@ -0,0 +1,90 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <QVector>
+
+#include "arena.h"
+#include "confusionmatrix.h"
+#include "distance.h"
+
+// features of a set of glyphs, one row per glyph (row-major)
+struct FeatureMatrix {
+    int rows = 0;
+    int cols = 0;
+    double *values = nullptr;    // owned by an arena
+    const int *labels = nullptr; // class id of every row
+
+    const double *row(int i) const { return values + i * cols; }
+    double *row(int i) { return values + i * cols; }
+};
+
+// uninitialized feature rows owned by the arena
+inline FeatureMatrix allocateFeatures(Arena &arena, int rows, int cols,
+                                      const int *labels) {
+    FeatureMatrix m;
+    m.rows = rows;
+    m.cols = cols;
+    m.values = arena.allocate<double>(rows * cols);
+    m.labels = labels;
+    return m;
+}
+
+// a train/test partition, given as row indices into the features (or the
+// packed glyphs) of a dataset
+struct Fold {
+    QVector<int> train;
+    QVector<int> test;
+};
+
+struct FoldResult {
+    double accuracy = 0;
+    QVector<int> correct; // correct predictions per class
+    KernelStats kernel;
+};
+
+struct EvaluationResult {
+    int folds = 0;
+    double meanAccuracy = 0;
+    double varAccuracy = 0;
+    QVector<double> foldAccuracy;
+    QVector<double> meanClassAccuracy;
+    QVector<double> varClassAccuracy;
+    // ops summed over all folds, over the wall time of the concurrent
+    // folds (so the throughput of the whole pool)
+    KernelStats kernel;
+    qint64 kernelCpuNsecs = 0; // kernel time summed over the folds
+};
+
+// scores 1-nn predictions: nearest[k] is the train sample found for test
+// sample k, or -1 when there was none (e.g. every score NaN), which counts
+// as wrong and is left out of the confusion counts. predictions are added
+// to confusion and the correct ones per class to correctByClass, when
+// given; returns the number of correct predictions
+int scoreNearest(const QVector<int> &nearest, const int *trainLabels,
+                 const int *testLabels, ConfusionCounts *confusion,
+                 QVector<int> *correctByClass = nullptr);
+
+// stratified fold generators (deterministic for a given seed)
+QVector<Fold> kFolds(const QVector<int> &labels, int numClasses, int k,
+                     unsigned seed);
+QVector<Fold> repeatedSplits(const QVector<int> &labels, int numClasses,
+                             int repeats, double testFraction, unsigned seed);
+
+// 1-nn evaluation of a single fold, with l1 over the feature rows of m or
+// with a binary metric over packed glyphs (labels[i] is the class of row
+// i). every prediction is also added to total, when given
+FoldResult evaluateFold(const FeatureMatrix &m, const Fold &fold,
+                        int numClasses, ConfusionCounts *total = nullptr);
+FoldResult evaluateFold(const BitMatrix &packed, const int *labels,
+                        const Fold &fold, Metric metric, int numClasses,
+                        ConfusionCounts *total = nullptr);
+
+// evaluates all folds in parallel and aggregates their statistics; the
+// confusion counts of all folds are summed into total
+EvaluationResult evaluate(const FeatureMatrix &m, const QVector<Fold> &folds,
+                          int numClasses, ConfusionCounts *total = nullptr);
+EvaluationResult evaluate(const BitMatrix &packed, const int *labels,
+                          const QVector<Fold> &folds, Metric metric,
+                          int numClasses, ConfusionCounts *total = nullptr);
+
+#endif // EVALUATION_H
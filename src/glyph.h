@@ -0,0 +1,61 @@
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <QtGlobal>
+#include <cstring>
+
+#include "arena.h"
+
+// a binary image, or a window of one, stored one byte per pixel twice:
+// row-major, img[y][x] addressing pixels like the nested vectors it
+// replaces, and column-major, img.column(x)[y], so that extractors walking
+// down the columns read sequential memory as well
+struct Glyph {
+    uchar *pixels = nullptr;
+    uchar *columns = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;       // bytes between two rows
+    int columnStride = 0; // bytes between two columns
+
+    const uchar *operator[](int y) const { return pixels + y * stride; }
+    uchar *operator[](int y) { return pixels + y * stride; }
+    const uchar *column(int x) const { return columns + x * columnStride; }
+
+    // sub-image sharing the pixels of this one
+    Glyph window(int x, int y, int w, int h) const {
+        Glyph g;
+        g.pixels = pixels + y * stride + x;
+        g.columns = columns + x * columnStride + y;
+        g.width = w;
+        g.height = h;
+        g.stride = stride;
+        g.columnStride = columnStride;
+        return g;
+    }
+};
+
+// zero-filled glyph owned by the arena
+inline Glyph allocateGlyph(Arena &arena, int width, int height) {
+    Glyph g;
+    g.pixels = arena.allocate<uchar>(2 * width * height);
+    g.columns = g.pixels + width * height;
+    g.width = width;
+    g.height = height;
+    g.stride = width;
+    g.columnStride = height;
+    memset(g.pixels, 0, 2 * width * height);
+    return g;
+}
+
+// copies the rows into the column-major pixels; called once the image has
+// been written through operator[]
+inline void transposeGlyph(Glyph &g) {
+    for (int y = 0; y < g.height; y++) {
+        const uchar *row = g[y];
+        for (int x = 0; x < g.width; x++)
+            g.columns[x * g.columnStride + y] = row[x];
+    }
+}
+
+#endif // GLYPH_H
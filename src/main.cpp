@@ -1,7 +1,39 @@
 #include "mainwindow.h"
+#include "runhistory.h"
 #include <QApplication>
+#include <QTextStream>
+
+// ocr-2018 --compare <baseline build> <candidate build> [history file]
+// compares every configuration run by both builds and exits with 1 when any
+// of them regressed, so scripts can stop a build that got slower or worse
+static int compare(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QString path = args.size() > 4 ? args[4] : defaultHistoryPath();
+
+    QTextStream out(stdout);
+    QVector<RunComparison> comparisons =
+        compareBuilds(loadRuns(path), args[2], args[3]);
+    if (comparisons.isEmpty()) {
+        out << "No configuration was run by both builds in " << path << "\n";
+        return 2;
+    }
+
+    int regressions = 0;
+    for (const RunComparison &c : comparisons) {
+        out << c.report().join("\n") << "\n";
+        if (c.regression())
+            regressions++;
+    }
+    out << regressions << " of " << comparisons.size()
+        << " configurations regressed\n";
+    return regressions ? 1 : 0;
+}
 
 int main(int argc, char *argv[]) {
+    if (argc >= 4 && QString(argv[1]) == "--compare")
+        return compare(argc, argv);
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
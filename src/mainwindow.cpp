@@ -1,18 +1,50 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QInputDialog>
+#include <QThreadPool>
 #include <math.h>
 
+// row pointers of a feature matrix, as the distance kernels take them
+static QVector<const double *> row_pointers(const FeatureMatrix &m) {
+    QVector<const double *> rows(m.rows);
+    for (int i = 0; i < m.rows; i++)
+        rows[i] = m.row(i);
+    return rows;
+}
+
+// the rows 0..n-1 of a bit matrix
+static QVector<int> all_rows(int n) {
+    QVector<int> rows(n);
+    for (int i = 0; i < n; i++)
+        rows[i] = i;
+    return rows;
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
     ui->setupUi(this);
 
+    // confussion matrix window, reused by every dataset and run
+    confusionModel = new ConfusionMatrixModel(&confusion, this);
+    uiConfussionMatrix = new QTableView();
+    uiConfussionMatrix->setModel(confusionModel);
+    uiConfussionMatrix->setWindowTitle("Confussion Matrix");
+
     // sender, signal, receiver, slot
     connect(ui->actionOpen, &QAction::triggered, this,
             &MainWindow::openDirectory);
+    connect(ui->actionExport, &QAction::triggered, this,
+            &MainWindow::exportConfussionMatrix);
+    connect(ui->actionCompare, &QAction::triggered, this,
+            &MainWindow::compareRunHistory);
     connect(ui->actionExit, &QAction::triggered, this, &MainWindow::Exit);
 }
 
 MainWindow::~MainWindow() {
+    delete uiConfussionMatrix;
     delete ui;
 }
 
@@ -35,9 +67,27 @@ void MainWindow::openDirectory() {
     ui->textBrowser->append("Loading images.. ");
     ui->textBrowser->moveCursor(QTextCursor::End);
 
+    // images are normalized (zero-padded) to the size of the largest one,
+    // at least 50x50, as they are loaded; every glyph (and so every feature
+    // row) has the same size. the sizes come from the image headers
+    maxWidth = 50;
+    maxHeight = 50;
+    for (auto const &subDir : subDirs) {
+        if (subDir == "." || subDir == "..")
+            continue;
+        QString subDirPath = mainDirPathString + "/" + subDir;
+        for (const QString &imgName : QDir(subDirPath).entryList()) {
+            if (imgName == "." || imgName == "..")
+                continue;
+            QSize size = QImageReader(subDirPath + "/" + imgName).size();
+            maxWidth = qMax(size.width(), maxWidth);
+            maxHeight = qMax(size.height(), maxHeight);
+        }
+    }
+    // square, as the vertical projections index pixels as cur_img[x][y]
+    maxWidth = maxHeight = qMax(maxWidth, maxHeight);
+
     int classId = 0;
-    int trainCount = 0;
-    int testCount = 0;
 
     // foreach class directory
     for (auto const &subDir : subDirs) {
@@ -49,14 +99,11 @@ void MainWindow::openDirectory() {
 
         // keep class mapping
         class_map[classId] = subDir;
-        class_count_map[classId] = 0;
 
         // get images in sub-directory
         QDir subDirD(subDirPath);
         QStringList imagesStrings = subDirD.entryList();
 
-        QVector<QVector<QVector<int>>> *tVector;
-
         // foreach image in sub-directory (class directory)
         foreach (QString imgName, imagesStrings) {
             if (imgName == "." || imgName == "..")
@@ -67,205 +114,162 @@ void MainWindow::openDirectory() {
                 imgName.split(".", QString::SkipEmptyParts).at(0).toInt();
 
             // get image
-            QFile *f = new QFile(subDirPath + "/" + imgName);
-            QImage Image = QImage(f->fileName());
+            QImage Image = QImage(subDirPath + "/" + imgName);
 
             int Ix = Image.width();
             int Iy = Image.height();
             int bpp = Image.depth();
 
-            if (imgId % 2 == 0) {
-                tVector = &test_images; // test set
-                testset.resize(testset.size() + 1);
-                testset[testCount].resize(1);
-                testset[testCount][0] = classId;
-                testCount++;
-                class_count_map[classId]++;
-            } else {
-                tVector = &train_images; // train set
-                trainset.resize(trainset.size() + 1);
-                trainset[trainCount].resize(1);
-                trainset[trainCount][0] = classId;
-                trainCount++;
-            }
-
-            QVector<QVector<int>> img;
-            img.resize(Iy);
-
-            if (bpp == 1) // binary
+            if (bpp != 1) // not binary
             {
-                for (int y = 0; y < Iy; y++) {
-                    img[y].resize(Ix);
-                    for (int x = 0; x < Ix; x++) {
-                        if (Image.pixel(x, y) == qRgb(0, 0, 0))
-                            img[y][x] = 1;
-                        else
-                            img[y][x] = 0;
-                    }
-                }
-            } else {
                 ui->textBrowser->append("Wrong Input: Pictures must be binary");
                 CleanMemory();
                 QApplication::restoreOverrideCursor();
                 return;
             }
 
-            // add image to vector
-            tVector->push_back(img);
+            // pixels live in the glyph arena, padded to maxWidth/maxHeight
+            // (an image larger than its header said is cropped)
+            Glyph img = allocateGlyph(glyphArena, maxWidth, maxHeight);
+            for (int y = 0; y < qMin(Iy, maxHeight); y++)
+                for (int x = 0; x < qMin(Ix, maxWidth); x++)
+                    if (Image.pixel(x, y) == qRgb(0, 0, 0))
+                        img[y][x] = 1;
+            transposeGlyph(img);
 
-            // keep max width,height
-            if (Ix > maxWidth)
-                maxWidth = Ix;
-            if (Iy > maxHeight)
-                maxHeight = Iy;
+            if (imgId % 2 == 0) {
+                test_images.push_back(img); // test set
+                test_labels.push_back(classId);
+            } else {
+                train_images.push_back(img); // train set
+                train_labels.push_back(classId);
+            }
         }
         classId++;
     }
     ui->textBrowser->insertPlainText("DONE");
+    datasetHash = dataset_hash();
 
     QString information = "";
-    //    information += "maxWidth:" + QString::number(maxWidth);
-    //    information += "\nmaxHeight:" + QString::number(maxHeight);
     information += "Trainset size: " + QString::number(train_images.size());
     information += "\nTestset size:" + QString::number(test_images.size());
     ui->textBrowser->append(information);
-
-    // ad-hoc values, depended on maxWidth/maxHeight
-    maxWidth = 50;
-    maxHeight = 50;
-
-    // normalize
-    ui->textBrowser->append("Normalizing.. ");
-    ui->textBrowser->moveCursor(QTextCursor::End);
-    Normalize(maxWidth, maxHeight, train_images);
-    Normalize(maxWidth, maxHeight, test_images);
-    ui->textBrowser->insertPlainText("DONE");
+    showMemoryUsage();
     QApplication::restoreOverrideCursor();
 
     // setup confussion matrix
-    int numOfClasses = class_map.size();
-    uiConfussionMatrix = new QTableWidget(numOfClasses, numOfClasses);
-    uiConfussionMatrix->showGrid();
-    initializeConfussionMatrix(numOfClasses);
+    initializeConfussionMatrix();
 }
 
 // confussion matrix routines
 
 void MainWindow::resetConfussionMatrix() {
-    uiConfussionMatrix->clearContents();
-    for (int i = 0; i != confMatrix.size(); i++)
-        for (int j = 0; j != confMatrix[i].size(); j++)
-            confMatrix[i][j] = 0;
-}
-
-void MainWindow::initializeConfussionMatrix(int numOfClasses) {
-    confMatrix.resize(numOfClasses);
-    for (int i = 0; i != confMatrix.size(); i++) {
-        confMatrix[i].resize(numOfClasses);
-        for (int j = 0; j != confMatrix[i].size(); j++)
-            confMatrix[i][j] = 0;
-    }
+    confusion.clear();
+}
 
-    for (int i = 0; i != confMatrix.size(); i++) {
-        uiConfussionMatrix->setHorizontalHeaderItem(
-            i, new QTableWidgetItem(class_map[i]));
-        uiConfussionMatrix->setVerticalHeaderItem(
-            i, new QTableWidgetItem(class_map[i]));
-    }
+void MainWindow::initializeConfussionMatrix() {
+    confusionModel->reset(class_names());
+}
+
+QStringList MainWindow::class_names() {
+    QStringList names;
+    for (int i = 0; i != class_map.size(); i++)
+        names << class_map[i];
+    return names;
 }
 
 void MainWindow::showConfussionMatrix() {
-    for (int i = 0; i != confMatrix.size(); i++) {
-        for (int j = 0; j != confMatrix[i].size(); j++) {
-            if (confMatrix[i][j] != 0 || i == j) {
-                if (i == j) {
-                    QString v = QString::number(confMatrix[i][j]) + "/" +
-                                QString::number(class_count_map[i]);
-                    uiConfussionMatrix->setItem(i, j, new QTableWidgetItem(v));
-                } else
-                    uiConfussionMatrix->setItem(
-                        i, j,
-                        new QTableWidgetItem(
-                            QString::number(confMatrix[i][j])));
-            }
-        }
-    }
-    uiConfussionMatrix->setWindowTitle("Confussion Matrix");
+    // the engines only touch the counters; the view repaints from them here
+    confusionModel->refresh();
     uiConfussionMatrix->show();
 }
 
-// normalization of images
-
-void MainWindow::Normalize(int maxWidth, int maxHeight,
-                           QVector<QVector<QVector<int>>> &v) {
-    for (int i = 0; i != v.size(); i++) {
-        QVector<QVector<int>> *img = &v[i];
-        int y = img->size();
-        int x = (*img)[0].size();
-        if (y < maxHeight) {
-            img->resize(maxHeight);
-            for (int yt = y; yt < maxHeight; yt++) {
-                (*img)[yt].resize(x);
-                for (int xt = 0; xt < x; xt++)
-                    (*img)[yt][xt] = 0;
-            }
-            y = img->size();
-        }
-        if (x < maxWidth) {
-            for (int yt = 0; yt < y; yt++) {
-                (*img)[yt].resize(maxWidth);
-                for (int xt = x; xt < maxWidth; xt++)
-                    (*img)[yt][xt] = 0;
-            }
-        }
+void MainWindow::exportConfussionMatrix() {
+    if (!confusion.classes()) {
+        ui->textBrowser->append("No images loaded yet!");
+        return;
     }
+    QString path = QFileDialog::getSaveFileName(
+        this, tr("Export Confussion Matrix"), "", tr("CSV files (*.csv)"));
+    if (path.isNull())
+        return;
+    if (confusion.exportCsv(path, class_names()))
+        ui->textBrowser->append("Confussion matrix exported to " + path);
+    else
+        ui->textBrowser->append("Could not write " + path);
 }
 
 // cleanup routines
 
 void MainWindow::cleanConfussionMatrix() {
-    confMatrix.clear();
-    confMatrix.squeeze();
-    if (uiConfussionMatrix != nullptr)
-        delete uiConfussionMatrix;
+    confusionModel->reset(QStringList());
+    uiConfussionMatrix->hide();
 }
 
 void MainWindow::CleanMemory() {
     // clear confussion matrix
     cleanConfussionMatrix();
 
-    // clear raw image values
+    // clear raw image values (the arena keeps its blocks for the next load)
     train_images.clear();
     test_images.clear();
-    train_images.squeeze();
-    test_images.squeeze();
+    train_labels.clear();
+    test_labels.clear();
+    glyphArena.reset();
 
-    // clear image class and features
-    trainset.clear();
-    testset.clear();
-    trainset.squeeze();
-    testset.squeeze();
+    // clear features
+    CleanFeatures();
 
     // clear class map
     class_map.clear();
-    class_count_map.clear();
+    datasetHash.clear();
 
     maxWidth = -999;
     maxHeight = -999;
 }
 
 void MainWindow::CleanFeatures() {
-    for (int i = 0; i < trainset.size(); i++)
-        trainset[i].resize(1);
-    for (int i = 0; i < testset.size(); i++)
-        testset[i].resize(1);
+    trainset = FeatureMatrix();
+    testset = FeatureMatrix();
+    featureArena.reset();
 }
 
 void MainWindow::Exit() {
     CleanMemory();
+    glyphArena.release();
+    featureArena.release();
     QCoreApplication::exit(0);
 }
 
+void MainWindow::showMemoryUsage() {
+    QString information = "Memory usage (current / peak / reserved KB):";
+    for (const Arena *arena : {&glyphArena, &featureArena})
+        information += "\n  " + arena->name() + ": " +
+                       QString::number(arena->usedBytes() / 1024) + " / " +
+                       QString::number(arena->peakBytes() / 1024) + " / " +
+                       QString::number(arena->reservedBytes() / 1024);
+    ui->textBrowser->append(information);
+}
+
+// hash of the class names, labels and pixels of the loaded images
+QString MainWindow::dataset_hash() {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (int c = 0; c != class_map.size(); c++)
+        hash.addData(class_map[c].toUtf8());
+    for (const QVector<Glyph> *images : {&train_images, &test_images})
+        for (const Glyph &img : *images) {
+            int size[] = {img.width, img.height};
+            hash.addData(reinterpret_cast<const char *>(size), sizeof(size));
+            for (int y = 0; y != img.height; y++)
+                hash.addData(reinterpret_cast<const char *>(img[y]),
+                             img.width);
+        }
+    for (const QVector<int> *labels : {&train_labels, &test_labels})
+        hash.addData(reinterpret_cast<const char *>(labels->constData()),
+                     labels->size() * sizeof(int));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
 // when start-classification is clicked
 
 void MainWindow::on_startButton_clicked() {
@@ -274,11 +278,58 @@ void MainWindow::on_startButton_clicked() {
         return;
     }
 
+    // every method extracts its own features, so the previous run's are
+    // dropped before the peaks are reset to what this run starts with
+    CleanFeatures();
+    glyphArena.resetPeak();
+    featureArena.resetPeak();
+
     resetConfussionMatrix();
     double accuracy = -3;
-    QTime myTimer;
+    EvaluationResult evaluation;
+    kernelStats = KernelStats();
+    runReport.clear();
+    runStages.clear();
+    untimedNsecs = 0;
+    QElapsedTimer myTimer;
     myTimer.start();
 
+    if (ui->evaluationComboBox->currentIndex() == 0)
+        accuracy = classifyFixedSplit();
+    else
+        accuracy = crossValidate(evaluation);
+
+    QApplication::restoreOverrideCursor();
+    qint64 totalNsecs = myTimer.nsecsElapsed() - untimedNsecs;
+    int ms = totalNsecs / 1000000;
+    QString out = QString("%1:%2")
+                      .arg(ms / 60000, 2, 10, QChar('0'))
+                      .arg((ms % 60000) / 1000, 2, 10, QChar('0'));
+    ui->textBrowser->insertPlainText(" (" + out + ")");
+    ui->textBrowser->append("Accuracy = " + QString::number(accuracy) + "%");
+    bool binary =
+        ui->jaccardButton->isChecked() || ui->yuleButton->isChecked();
+    ui->textBrowser->append(
+        "Distance kernel: " +
+        QString::number(kernelStats.gigaOpsPerSec(), 'f', 2) +
+        (binary ? " Gpopcount/s" : " GFLOP/s"));
+    for (const QString &line : runReport)
+        ui->textBrowser->append(line);
+    if (evaluation.folds)
+        showEvaluation(evaluation);
+    showMemoryUsage();
+    showConfussionMatrix();
+    recordRun(accuracy, evaluation, totalNsecs);
+}
+
+// classification on the fixed (odd/even image id) split
+
+double MainWindow::classifyFixedSplit() {
+    double accuracy = -3;
+
+    if (ui->cascadeCheckBox->isChecked())
+        return cascade();
+
     if (ui->jaccardButton->isChecked()) {
         ui->textBrowser->append("\nClassifying with jaccard distance..");
         QApplication::setOverrideCursor(Qt::WaitCursor);
@@ -296,8 +347,7 @@ void MainWindow::on_startButton_clicked() {
         ui->textBrowser->append("\nClassifying with " +
                                 ui->comboBox->currentText() + " projections..");
         QApplication::setOverrideCursor(Qt::WaitCursor);
-        projections(0);
-        projections(1);
+        extract(&MainWindow::projections);
         accuracy = classify();
     }
 
@@ -306,8 +356,7 @@ void MainWindow::on_startButton_clicked() {
         ui->textBrowser->append("\nClassifying with " +
                                 ui->comboBox_2->currentText() + " zones..");
         QApplication::setOverrideCursor(Qt::WaitCursor);
-        zones(0);
-        zones(1);
+        extract(&MainWindow::zones);
         accuracy = classify();
     }
 
@@ -319,51 +368,221 @@ void MainWindow::on_startButton_clicked() {
                                 QString::number(num_of_features) +
                                 ", L=" + ui->comboBox_4->currentText() + "]");
         QApplication::setOverrideCursor(Qt::WaitCursor);
-        subdivisions(0);
-        subdivisions(1);
+        extract(&MainWindow::subdivisions);
         accuracy = classify();
     }
 
-    QApplication::restoreOverrideCursor();
-    int ms = myTimer.elapsed();
-    QString out = QString("%1:%2")
-                      .arg(ms / 60000, 2, 10, QChar('0'))
-                      .arg((ms % 60000) / 1000, 2, 10, QChar('0'));
-    ui->textBrowser->insertPlainText(" (" + out + ")");
-    ui->textBrowser->append("Accuracy = " + QString::number(accuracy) + "%");
-    showConfussionMatrix();
+    return accuracy;
 }
 
-// classification routine
+// cross-validation
+
+QString MainWindow::methodDescription() {
+    if (ui->jaccardButton->isChecked())
+        return "jaccard distance";
+    if (ui->yuleButton->isChecked())
+        return "Yule distance";
+    if (ui->projectionsButton->isChecked())
+        return ui->comboBox->currentText() + " projections";
+    if (ui->zonesButton->isChecked())
+        return ui->comboBox_2->currentText() + " zones";
+    int num_of_features =
+        static_cast<int>(pow(4, ui->comboBox_4->currentText().toInt()));
+    return "subdivisions [features=" + QString::number(num_of_features) +
+           ", L=" + ui->comboBox_4->currentText() + "]";
+}
 
-double MainWindow::classify() {
-    int correct = 0;
-
-    // find euclidean distance from each pattern
-    for (int k = 0; k < testset.size(); k++) {
-        double mindist = 1000000;
-        int cclass = -4;
-
-        for (int i = 0; i < trainset.size(); i++) {
-            // euclidean distance
-            double distance = 0.0;
-            for (int j = 1; j < trainset[i].size(); j++) {
-                double td = trainset[i][j] - testset[k][j];
-                td = td < 0 ? -td : td;
-                distance += td;
-            }
+// computes the l1 features of every loaded image (train images followed
+// by test images) into a single matrix
+void MainWindow::extractFeatures(FeatureMatrix &m, const int *labels) {
+    int n = ui->comboBox->currentText().toInt();
+    int p = zone_size();
+    int gran = ui->comboBox_4->currentText().toInt();
+
+    int nTrain = train_images.size();
+    m = allocateFeatures(featureArena, nTrain + test_images.size(),
+                         feature_count(), labels);
+
+    for (int i = 0; i < m.rows; i++) {
+        const Glyph &img =
+            i < nTrain ? train_images[i] : test_images[i - nTrain];
+        double *f = m.row(i);
+
+        if (ui->projectionsButton->isChecked())
+            projection_features(img, n, f);
+        else if (ui->zonesButton->isChecked())
+            zone_features(img, p, f);
+        else
+            subdivision_features(img, gran, f);
+    }
+}
 
-            if (distance < mindist) {
-                mindist = distance;
-                cclass = static_cast<int>(trainset[i][0]);
-            }
-        }
+double MainWindow::crossValidate(EvaluationResult &res) {
+    const unsigned seed = 2018;
+    int numClasses = class_map.size();
+    int mode = ui->evaluationComboBox->currentIndex();
+
+    ui->textBrowser->append("\nCross-validating with " + methodDescription() +
+                            " [" + ui->evaluationComboBox->currentText() +
+                            "]..");
+    QApplication::setOverrideCursor(Qt::WaitCursor);
 
-        if (cclass == testset[k][0])
-            correct++;
-        confMatrix[cclass][int(testset[k][0])]++;
+    Metric metric = Metric::L1;
+    if (ui->jaccardButton->isChecked())
+        metric = Metric::Jaccard;
+    if (ui->yuleButton->isChecked())
+        metric = Metric::Yule;
+
+    // features are extracted once and shared by every fold; template
+    // matching works on the raw pixels, packed like in the fixed split
+    CleanFeatures();
+    QVector<int> labels = train_labels + test_labels;
+    FeatureMatrix m;
+    BitMatrix packed;
+    CacheCounters counters;
+    QElapsedTimer timer;
+    timer.start();
+    counters.start();
+    if (metric == Metric::L1)
+        extractFeatures(m, labels.constData());
+    else
+        packed = packGlyphs(train_images + test_images);
+    counters.stop();
+    runStages << RunStage{"feature extraction", timer.nsecsElapsed()};
+    runReport << "Feature extraction: " +
+                     QString::number(timer.nsecsElapsed() / 1000000) +
+                     " ms, " + counters.summary();
+
+    QVector<Fold> folds;
+    if (mode == 1)
+        folds = kFolds(labels, numClasses, 5, seed);
+    else if (mode == 2)
+        folds = kFolds(labels, numClasses, 10, seed);
+    else
+        folds = repeatedSplits(labels, numClasses, 10, 0.5, seed);
+
+    // folds add their predictions to the confussion matrix as they run
+    timer.restart();
+    if (metric == Metric::L1)
+        res = evaluate(m, folds, numClasses, &confusion);
+    else
+        res = evaluate(packed, labels.constData(), folds, metric, numClasses,
+                       &confusion);
+    runStages << RunStage{"fold evaluation", timer.nsecsElapsed()};
+    kernelStats = res.kernel;
+
+    return res.meanAccuracy;
+}
+
+void MainWindow::showEvaluation(const EvaluationResult &res) {
+    QString information = "Folds: " + QString::number(res.folds);
+    information += ", mean accuracy = " +
+                   QString::number(res.meanAccuracy) + "%";
+    information += ", variance = " + QString::number(res.varAccuracy);
+    information += "\nPer-class accuracy (mean% / variance):";
+    for (int c = 0; c != res.meanClassAccuracy.size(); c++)
+        information += "\n  " + class_map[c] + ": " +
+                       QString::number(res.meanClassAccuracy[c], 'f', 1) +
+                       " / " +
+                       QString::number(res.varClassAccuracy[c], 'f', 1);
+    ui->textBrowser->append(information);
+}
+
+// run history
+
+QJsonObject MainWindow::runParameters() {
+    QJsonObject params;
+    bool binary =
+        ui->jaccardButton->isChecked() || ui->yuleButton->isChecked();
+    if (ui->cascadeCheckBox->isChecked() &&
+        ui->evaluationComboBox->currentIndex() == 0) {
+        QJsonObject cascade;
+        cascade["coarse"] = ui->cascadeComboBox->currentText();
+        cascade["k"] = ui->cascadeSpinBox->value();
+        params["cascade"] = cascade;
+    } else if (binary && ui->lshCheckBox->isChecked() &&
+               ui->evaluationComboBox->currentIndex() == 0) {
+        QJsonObject lsh;
+        lsh["bands"] = ui->lshBandsSpinBox->value();
+        lsh["rows"] = ui->lshRowsSpinBox->value();
+        params["lsh"] = lsh;
     }
-    return ((double)correct * 100) / testset.size();
+    return params;
+}
+
+void MainWindow::recordRun(double accuracy, const EvaluationResult &res,
+                           qint64 totalNsecs) {
+    RunRecord run;
+    run.time = QDateTime::currentDateTime();
+    run.build = buildId();
+    run.dataset = datasetHash;
+    run.method = methodDescription();
+    run.evaluation = ui->evaluationComboBox->currentText();
+    run.params = runParameters();
+    run.threads = QThreadPool::globalInstance()->maxThreadCount();
+    run.stages = runStages;
+    // the folds of a cross-validation run their kernels concurrently; the
+    // kernel stage is their wall time, the cpu time is summed over folds
+    run.stages << RunStage{"distance kernel", kernelStats.nsecs};
+    if (res.folds)
+        run.stages << RunStage{"distance kernel cpu", res.kernelCpuNsecs};
+    run.totalNsecs = totalNsecs;
+    run.peakBytes = glyphArena.peakBytes() + featureArena.peakBytes();
+    run.accuracy = accuracy;
+    run.foldAccuracy = res.foldAccuracy;
+    run.classes = confusion.classes();
+    for (int p = 0; p != run.classes; p++)
+        for (int a = 0; a != run.classes; a++)
+            run.confusion.push_back(confusion.count(p, a));
+
+    QString path = defaultHistoryPath();
+    if (!appendRun(path, run))
+        ui->textBrowser->append("Could not record the run in " + path);
+}
+
+// compares two groups of recorded runs (builds and/or configurations)
+void MainWindow::compareRunHistory() {
+    QString path = defaultHistoryPath();
+    QVector<RunRecord> runs = loadRuns(path);
+
+    QMap<QString, QVector<RunRecord>> groups;
+    for (const RunRecord &run : runs)
+        groups["build " + run.build + ": " + run.configuration()].push_back(
+            run);
+    if (groups.size() < 2) {
+        ui->textBrowser->append("Not enough recorded runs in " + path);
+        return;
+    }
+
+    QStringList names = groups.keys();
+    bool ok;
+    QString base = QInputDialog::getItem(this, tr("Compare Runs"),
+                                         tr("Baseline:"), names, 0, false,
+                                         &ok);
+    if (!ok)
+        return;
+    QString cand = QInputDialog::getItem(this, tr("Compare Runs"),
+                                         tr("Candidate:"), names, 0, false,
+                                         &ok);
+    if (!ok)
+        return;
+
+    RunComparison comparison = compareRuns(groups[base], groups[cand]);
+    comparison.configuration = base + "\n  vs " + cand;
+    ui->textBrowser->append("\n" + comparison.report().join("\n"));
+}
+
+// classification routine
+
+double MainWindow::classify() {
+    // find l1 distance from each pattern
+    QVector<int> nearest = nearestL1(row_pointers(testset),
+                                     row_pointers(trainset), trainset.cols,
+                                     &kernelStats);
+
+    int correct = scoreNearest(nearest, trainset.labels, testset.labels,
+                               &confusion);
+    return ((double)correct * 100) / testset.rows;
 }
 
 // recursive subdivisions
@@ -394,20 +613,21 @@ int MainWindow::find_index(QVector<int> v1) {
     return min_index;
 }
 
-int MainWindow::find_vertical_point(QVector<QVector<int>> img) {
-    int image_height = img.size();
-    int image_width = img[0].size();
+int MainWindow::find_vertical_point(const Glyph &img) {
+    int image_height = img.height;
+    int image_width = img.width;
 
     // initialize v0 and fill it with zeros
     QVector<int> v0;
     v0.resize(image_width);
     for (int m = 0; m < image_width; m++)
         v0[m] = 0;
-    // foreach column of the image
+    // foreach column of the image (column-major, so each is sequential)
     for (int x = 0; x < image_width; x++) {
+        const uchar *column = img.column(x);
         // foreach row of the image
         for (int y = 0; y < image_height; y++) {
-            if (img[y][x]) {
+            if (column[y]) {
                 v0[x]++; // vertical pixels
             }
         }
@@ -431,9 +651,9 @@ int MainWindow::find_vertical_point(QVector<QVector<int>> img) {
     return Xq + 1;
 }
 
-int MainWindow::find_horizontal_point(QVector<QVector<int>> img) {
-    int image_height = img.size();
-    int image_width = img[0].size();
+int MainWindow::find_horizontal_point(const Glyph &img) {
+    int image_height = img.height;
+    int image_width = img.width;
 
     // initialize v0 and fill it with zeros
     QVector<int> v0;
@@ -465,43 +685,32 @@ int MainWindow::find_horizontal_point(QVector<QVector<int>> img) {
     return Yq + 1;
 }
 
-void MainWindow::recursive_mock(int gran, int choice, int si) {
+void MainWindow::recursive_mock(int gran, double *&features) {
     if (gran > 0) {
-        recursive_mock(gran - 1, choice, si);
-        recursive_mock(gran - 1, choice, si);
-        recursive_mock(gran - 1, choice, si);
-        recursive_mock(gran - 1, choice, si);
+        recursive_mock(gran - 1, features);
+        recursive_mock(gran - 1, features);
+        recursive_mock(gran - 1, features);
+        recursive_mock(gran - 1, features);
     } else {
-        if (!choice) {
-            trainset[si].push_back(0);
-            trainset[si].push_back(0);
-        } else {
-            testset[si].push_back(0);
-            testset[si].push_back(0);
-        }
+        *features++ = 0;
+        *features++ = 0;
     }
 }
 
-void MainWindow::recursive_div(QVector<QVector<int>> img, int gran, int choice,
-                               int si) {
-    int image_height = img.size();
-    int image_width = img[0].size();
+void MainWindow::recursive_div(const Glyph &img, int gran, double *&features) {
+    int image_height = img.height;
+    int image_width = img.width;
 
     // can't be split any further - just fill remaining features with (0,0)
     if (image_height < 3 || image_width < 3) {
         if (gran > 0) {
-            recursive_mock(gran - 1, choice, si);
-            recursive_mock(gran - 1, choice, si);
-            recursive_mock(gran - 1, choice, si);
-            recursive_mock(gran - 1, choice, si);
+            recursive_mock(gran - 1, features);
+            recursive_mock(gran - 1, features);
+            recursive_mock(gran - 1, features);
+            recursive_mock(gran - 1, features);
         } else {
-            if (!choice) {
-                trainset[si].push_back(0);
-                trainset[si].push_back(0);
-            } else {
-                testset[si].push_back(0);
-                testset[si].push_back(0);
-            }
+            *features++ = 0;
+            *features++ = 0;
         }
         return;
     }
@@ -512,123 +721,43 @@ void MainWindow::recursive_div(QVector<QVector<int>> img, int gran, int choice,
     int Yq = find_horizontal_point(img);
     int Y0 = Yq / 2;
 
-    // do sub-images
-
-    // left-up sub-image
-    QVector<QVector<int>> left_up_sub_img;
-    left_up_sub_img.resize(Y0);
-    for (int y = 0; y < Y0; y++) {
-        left_up_sub_img[y].resize(X0);
-        for (int x = 0; x < X0; x++) {
-            left_up_sub_img[y][x] = img[y][x];
-        }
-    }
+    // do sub-images (windows sharing the pixels of img); with an even split
+    // point the middle column/row belongs to both halves
+    int xfrom = Xq % 2 == 0 ? X0 - 1 : X0;
+    int yfrom = Yq % 2 == 0 ? Y0 - 1 : Y0;
 
-    // right-up sub-image
-    QVector<QVector<int>> right_up_sub_img;
-    right_up_sub_img.resize(Y0);
-    int xfrom = -1;
-    for (int y = 0; y < Y0; y++) {
-        // --
-        if (Xq % 2 == 0) {
-            xfrom = X0 - 1;
-            right_up_sub_img[y].resize(image_width - X0 + 1);
-        } else {
-            xfrom = X0;
-            right_up_sub_img[y].resize(image_width - X0);
-        }
-        // --
-        int xf = 0;
-        for (int x = xfrom; x < image_width; x++) {
-            right_up_sub_img[y][xf] = img[y][x];
-            xf++;
-        }
-    }
-
-    // left-down sub-image
-    QVector<QVector<int>> left_down_sub_img;
-    // --
-    int yfrom = -1;
-    if (Yq % 2 == 0) {
-        yfrom = Y0 - 1;
-        left_down_sub_img.resize(image_height - Y0 + 1);
-    } else {
-        yfrom = Y0;
-        left_down_sub_img.resize(image_height - Y0);
-    }
-    // --
-    int yf = 0;
-    for (int y = yfrom; y < image_height; y++) {
-        left_down_sub_img[yf].resize(X0);
-        for (int x = 0; x < X0; x++)
-            left_down_sub_img[yf][x] = img[y][x];
-        yf++;
-    }
-
-    // right-down sub-image
-    QVector<QVector<int>> right_down_sub_img;
-    // --
-    int yfrom2 = -1;
-    if (Yq % 2 == 0) {
-        yfrom2 = Y0 - 1;
-        right_down_sub_img.resize(image_height - Y0 + 1);
-    } else {
-        yfrom2 = Y0;
-        right_down_sub_img.resize(image_height - Y0);
-    }
-    // --
-    int z2 = 0;
-    int xfrom2 = -1;
-    for (int y = yfrom2; y < image_height; y++) {
-        // --
-        if (Xq % 2 == 0) {
-            xfrom2 = X0 - 1;
-            right_down_sub_img[z2].resize(image_width - X0 + 1);
-        } else {
-            xfrom2 = X0;
-            right_down_sub_img[z2].resize(image_width - X0);
-        }
-        // --
-        int q = 0;
-        for (int x = xfrom2; x < image_width; x++) {
-            right_down_sub_img[z2][q] = img[y][x];
-            q++;
-        }
-        z2++;
-    }
+    Glyph left_up_sub_img = img.window(0, 0, X0, Y0);
+    Glyph right_up_sub_img = img.window(xfrom, 0, image_width - xfrom, Y0);
+    Glyph left_down_sub_img = img.window(0, yfrom, X0, image_height - yfrom);
+    Glyph right_down_sub_img = img.window(
+        xfrom, yfrom, image_width - xfrom, image_height - yfrom);
 
     if (gran > 0) {
-        recursive_div(left_up_sub_img, gran - 1, choice, si);
-        recursive_div(right_up_sub_img, gran - 1, choice, si);
-        recursive_div(left_down_sub_img, gran - 1, choice, si);
-        recursive_div(right_down_sub_img, gran - 1, choice, si);
+        recursive_div(left_up_sub_img, gran - 1, features);
+        recursive_div(right_up_sub_img, gran - 1, features);
+        recursive_div(left_down_sub_img, gran - 1, features);
+        recursive_div(right_down_sub_img, gran - 1, features);
     } else {
-        if (!choice) {
-            trainset[si].push_back(X0);
-            trainset[si].push_back(Y0);
-        } else {
-            testset[si].push_back(X0);
-            testset[si].push_back(Y0);
-        }
+        *features++ = X0;
+        *features++ = Y0;
     }
 }
 
+void MainWindow::subdivision_features(const Glyph &img, int gran,
+                                      double *features) {
+    recursive_div(img, gran, features);
+}
+
 void MainWindow::subdivisions(short choice) {
     // assign level of granularity for subdivisions
     int n = ui->comboBox_4->currentText().toInt();
 
-    QVector<QVector<QVector<int>>> *choice_vector;
-
-    if (!choice)
-        choice_vector = &train_images;
-    else
-        choice_vector = &test_images;
+    const QVector<Glyph> &choice_vector = !choice ? train_images : test_images;
+    FeatureMatrix &features = allocate_features(choice, feature_count());
 
     // for every image of the vector
-    for (int m = 0; m < choice_vector->size(); m++) {
-        QVector<QVector<int>> cur_img = (*choice_vector)[m]; // current image
-        recursive_div(cur_img, n, choice, m);
-    }
+    for (int m = 0; m < choice_vector.size(); m++)
+        subdivision_features(choice_vector[m], n, features.row(m));
 }
 
 // projections
@@ -637,45 +766,48 @@ void MainWindow::projections(short choice) {
     // assign projections
     int n = ui->comboBox->currentText().toInt();
 
-    QVector<QVector<QVector<int>>> *choice_vector;
-
-    if (!choice)
-        choice_vector = &train_images;
-    else
-        choice_vector = &test_images;
+    const QVector<Glyph> &choice_vector = !choice ? train_images : test_images;
+    FeatureMatrix &features = allocate_features(choice, feature_count());
 
     // for every image of the vector
-    for (int m = 0; m < choice_vector->size(); m++) {
-        QVector<QVector<int>> cur_img = (*choice_vector)[m]; // current image
-        // for every projection
-        for (int k = 1; k <= n; k++) {
-            int rpixels = 0;
-            int cpixels = 0;
-            // traverse pixels
-            for (int y = 0; y < k * cur_img.size() / n; y++) {
-                for (int x = 0; x < cur_img[0].size(); x++) {
-                    if (cur_img[y][x])
-                        rpixels++; // horizontal projections
-                    if (cur_img[x][y])
-                        cpixels++; // vertical projections
-                }
-            }
+    for (int m = 0; m < choice_vector.size(); m++)
+        projection_features(choice_vector[m], n, features.row(m));
+}
 
-            if (!choice) {
-                trainset[m].push_back((double)rpixels);
-                trainset[m].push_back((double)cpixels);
-            } else {
-                testset[m].push_back((double)rpixels);
-                testset[m].push_back((double)cpixels);
-            }
+void MainWindow::projection_features(const Glyph &cur_img, int n,
+                                     double *features) {
+    // pixels of every row, read from the rows, and of every column, read
+    // from the column-major copy (cur_img[x][y] is cur_img.column(y)[x])
+    QVector<int> row_pixels(cur_img.height, 0);
+    QVector<int> col_pixels(cur_img.height, 0);
+    for (int y = 0; y < cur_img.height; y++) {
+        const uchar *row = cur_img[y];
+        const uchar *column = cur_img.column(y);
+        for (int x = 0; x < cur_img.width; x++) {
+            row_pixels[y] += row[x];
+            col_pixels[y] += column[x];
         }
     }
+
+    // for every projection, the pixels of its first k * height / n rows
+    // and columns
+    int rpixels = 0;
+    int cpixels = 0;
+    int y = 0;
+    for (int k = 1; k <= n; k++) {
+        for (; y < k * cur_img.height / n; y++) {
+            rpixels += row_pixels[y]; // horizontal projections
+            cpixels += col_pixels[y]; // vertical projections
+        }
+        *features++ = (double)rpixels;
+        *features++ = (double)cpixels;
+    }
 }
 
 // zones
 
-void MainWindow::zones(short choice) {
-    int p;
+int MainWindow::zone_size() {
+    int p = 2;
     if (ui->comboBox_2->currentText() == "2x2")
         p = 2;
     if (ui->comboBox_2->currentText() == "5x5")
@@ -684,88 +816,283 @@ void MainWindow::zones(short choice) {
         p = 10;
     if (ui->comboBox_2->currentText() == "25x25")
         p = 25;
+    return p;
+}
 
-    QVector<QVector<QVector<int>>> *choice_vector;
+void MainWindow::zones(short choice) {
+    int p = zone_size();
 
-    if (!choice)
-        choice_vector = &train_images;
-    else
-        choice_vector = &test_images;
+    const QVector<Glyph> &choice_vector = !choice ? train_images : test_images;
+    FeatureMatrix &features = allocate_features(choice, feature_count());
 
     // for every image
-    for (int m = 0; m < choice_vector->size(); m++) {
-        QVector<QVector<int>> cur_img = (*choice_vector)[m]; // current image
-        for (int k = 0; k < cur_img.size() / p; k++) {
-            for (int l = 0; l < cur_img[0].size() / p; l++) {
-                int pixels = 0;
-                for (int y = k * p; y < ((k + 1) * p); y++) {
-                    for (int x = l * p; x < ((l + 1) * p); x++) {
-                        if (cur_img[y][x])
-                            pixels++;
-                    }
-                }
-                if (!choice)
-                    trainset[m].push_back((double)pixels / (p * p));
-                else
-                    testset[m].push_back((double)pixels / (p * p));
-            }
+    for (int m = 0; m < choice_vector.size(); m++)
+        zone_features(choice_vector[m], p, features.row(m));
+}
+
+void MainWindow::zone_features(const Glyph &cur_img, int p, double *features) {
+    int zone_rows = cur_img.height / p;
+    int zone_cols = cur_img.width / p;
+    for (int z = 0; z < zone_rows * zone_cols; z++)
+        features[z] = 0;
+
+    // one pass down the rows instead of a p x p walk per zone; every row
+    // adds its pixels to the zones it crosses
+    for (int y = 0; y < zone_rows * p; y++) {
+        const uchar *row = cur_img[y];
+        double *zone = features + (y / p) * zone_cols;
+        for (int l = 0; l < zone_cols; l++) {
+            int pixels = 0;
+            for (int x = l * p; x < ((l + 1) * p); x++)
+                pixels += row[x];
+            zone[l] += pixels;
         }
     }
+    for (int z = 0; z < zone_rows * zone_cols; z++)
+        features[z] /= p * p;
+}
+
+// feature rows
+
+// runs an extractor over the train and test images, reporting its time and
+// the cache miss rates of the extraction
+void MainWindow::extract(void (MainWindow::*extractor)(short)) {
+    CacheCounters counters;
+    QElapsedTimer timer;
+    timer.start();
+    counters.start();
+    (this->*extractor)(0);
+    (this->*extractor)(1);
+    counters.stop();
+    runStages << RunStage{"feature extraction", timer.nsecsElapsed()};
+    runReport << "Feature extraction: " +
+                     QString::number(timer.nsecsElapsed() / 1000000) +
+                     " ms, " + counters.summary();
+}
+
+// length of a feature row for the selected method
+int MainWindow::feature_count() {
+    const Glyph &img = train_images[0];
+    if (ui->jaccardButton->isChecked() || ui->yuleButton->isChecked())
+        return img.width * img.height;
+    if (ui->projectionsButton->isChecked())
+        return 2 * ui->comboBox->currentText().toInt();
+    if (ui->zonesButton->isChecked()) {
+        int p = zone_size();
+        return (img.height / p) * (img.width / p);
+    }
+    return 2 * static_cast<int>(pow(4, ui->comboBox_4->currentText().toInt()));
+}
+
+// feature rows of the train (0) or test (1) images, from the feature arena
+FeatureMatrix &MainWindow::allocate_features(short choice, int cols) {
+    if (!choice) {
+        trainset = allocateFeatures(featureArena, train_images.size(), cols,
+                                    train_labels.constData());
+        return trainset;
+    }
+    testset = allocateFeatures(featureArena, test_images.size(), cols,
+                               test_labels.constData());
+    return testset;
 }
 
 // jaccard-yule distances
 
 double MainWindow::jaccard_yule(short choice) {
-    int correct = 0;
-
-    // for every test image
-    for (int i = 0; i != test_images.size(); i++) {
-        double maxdist = -1000000;
-        int cclass = -4;
-
-        // for every train image
-        for (int j = 0; j != train_images.size(); j++) {
-            double n11 = 0;
-            double n10 = 0;
-            double n01 = 0;
-            double n00 = 0;
-
-            // traverse pixels
-            for (int y = 0; y != train_images[0].size(); y++) {
-                for (int x = 0; x != train_images[0][0].size(); x++) {
-                    if (test_images[i][y][x] == 1 && train_images[j][y][x] == 1)
-                        n11++;
-                    else if (test_images[i][y][x] == 1 &&
-                             train_images[j][y][x] == 0)
-                        n10++;
-                    else if (test_images[i][y][x] == 0 &&
-                             train_images[j][y][x] == 0)
-                        n00++;
-                    else if (test_images[i][y][x] == 0 &&
-                             train_images[j][y][x] == 1)
-                        n01++;
-                }
-            }
+    // pack pixels so n11 of every pair is a popcount of an and; n10, n01
+    // and n00 follow from the set pixels of each image
+    BitMatrix test = packGlyphs(test_images);
+    BitMatrix train = packGlyphs(train_images);
+    QVector<int> testRows = all_rows(test.rows);
+    QVector<int> trainRows = all_rows(train.rows);
+
+    Metric metric = choice == 0 ? Metric::Jaccard : Metric::Yule;
+    QVector<int> nearest;
+    if (ui->lshCheckBox->isChecked())
+        nearest = lsh_nearest(test, testRows, train, trainRows, metric);
+    else
+        nearest = nearestBinary(test, testRows, train, trainRows, metric,
+                                &kernelStats);
+
+    int correct = scoreNearest(nearest, train_labels.constData(),
+                               test_labels.constData(), &confusion);
+    return ((double)correct * 100) / test_images.size();
+}
+
+// approximate search: lsh candidates reranked exactly, reported against
+// the exact search for recall@1 and speedup
+
+QVector<int> MainWindow::lsh_nearest(const BitMatrix &test,
+                                     const QVector<int> &testRows,
+                                     const BitMatrix &train,
+                                     const QVector<int> &trainRows,
+                                     Metric metric) {
+    LshParams params;
+    params.bands = ui->lshBandsSpinBox->value();
+    params.rows = ui->lshRowsSpinBox->value();
+
+    LshStats lsh;
+    QVector<int> nearest = nearestBinaryLsh(
+        test, testRows, train, trainRows, metric, params, &kernelStats, &lsh);
+
+    runStages << RunStage{"lsh build", lsh.buildNsecs}
+              << RunStage{"lsh query", lsh.queryNsecs};
+    runReport << "LSH [bands=" + QString::number(params.bands) +
+                     ", rows=" + QString::number(params.rows) +
+                     "]: candidates/query = " +
+                     QString::number(double(lsh.candidates) / nearest.size(),
+                                     'f', 1) +
+                     " of " + QString::number(trainRows.size()) +
+                     ", fallbacks = " + QString::number(lsh.fallbacks);
+    runReport << "LSH time: build " +
+                     QString::number(lsh.buildNsecs / 1000000) +
+                     " ms, query " +
+                     QString::number(lsh.queryNsecs / 1000000) + " ms";
+    if (!ui->lshRecallCheckBox->isChecked())
+        return nearest;
+
+    // exact search as the recall/speedup baseline; not part of the run's
+    // latency, which is that of the approximate search alone
+    QElapsedTimer exactTimer;
+    exactTimer.start();
+    QVector<int> exact =
+        nearestBinary(test, testRows, train, trainRows, metric);
+    qint64 exactNsecs = exactTimer.nsecsElapsed();
+    untimedNsecs += exactNsecs;
+
+    int hits = 0;
+    for (int i = 0; i != nearest.size(); i++)
+        if (nearest[i] == exact[i])
+            hits++;
+
+    double approxNsecs = lsh.buildNsecs + lsh.queryNsecs;
+    runReport << "LSH recall@1 = " +
+                     QString::number(hits * 100.0 / nearest.size(), 'f', 2) +
+                     "%, exact " + QString::number(exactNsecs / 1000000) +
+                     " ms, speedup = " +
+                     QString::number(approxNsecs ? exactNsecs / approxNsecs
+                                                 : 0,
+                                     'f', 2) +
+                     "x";
+    return nearest;
+}
 
-            double distance;
+// cascade: a cheap extractor shortlists k train images per test image with
+// l1, and only the shortlist is rescored with the selected method
 
-            // jaccard
-            if (choice == 0)
-                distance = n11 / (n11 + n10 + n01);
-            // yule
-            else
-                distance =
-                    ((n11 * n00) - (n10 * n01)) / ((n11 * n00) + (n10 * n01));
+void MainWindow::coarse_features(short choice) {
+    const QVector<Glyph> &choice_vector = !choice ? train_images : test_images;
+    const Glyph &img = train_images[0];
 
-            if (distance > maxdist) {
-                maxdist = distance;
-                cclass = trainset[j][0];
+    // same order as the items of cascadeComboBox
+    static const int params[] = {2, 5, 2, 5, 0, 1};
+    int mode = ui->cascadeComboBox->currentIndex();
+    int q = params[mode];
+
+    int cols;
+    if (mode < 2)
+        cols = 2 * q;
+    else if (mode < 4)
+        cols = (img.height / q) * (img.width / q);
+    else
+        cols = 2 * static_cast<int>(pow(4, q));
+    FeatureMatrix &features = allocate_features(choice, cols);
+
+    for (int m = 0; m < choice_vector.size(); m++) {
+        if (mode < 2)
+            projection_features(choice_vector[m], q, features.row(m));
+        else if (mode < 4)
+            zone_features(choice_vector[m], q, features.row(m));
+        else
+            subdivision_features(choice_vector[m], q, features.row(m));
+    }
+}
+
+double MainWindow::cascade() {
+    int k = ui->cascadeSpinBox->value();
+    ui->textBrowser->append("\nClassifying with cascade [" +
+                            ui->cascadeComboBox->currentText() + " -> " +
+                            methodDescription() +
+                            ", k=" + QString::number(k) + "]..");
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QElapsedTimer timer;
+
+    // the recorded stages don't overlap: coarse extraction, stage 1 (the
+    // shortlist), fine extraction and stage 2 (the rescoring)
+
+    // stage 1: cheap features, l1 shortlist
+    timer.start();
+    CleanFeatures();
+    coarse_features(0);
+    coarse_features(1);
+    qint64 extractNsecs = timer.nsecsElapsed();
+    timer.restart();
+    KernelStats coarse;
+    QVector<int> shortlist =
+        nearestL1K(row_pointers(testset), row_pointers(trainset),
+                   trainset.cols, k, &coarse);
+    qint64 stage1 = timer.nsecsElapsed();
+
+    // test images whose class made it into the shortlist (an upper bound
+    // for the accuracy of the second stage)
+    int covered = 0;
+    for (int i = 0; i != test_images.size(); i++)
+        for (int m = 0; m < k; m++) {
+            int j = shortlist[i * k + m];
+            if (j >= 0 && train_labels[j] == test_labels[i]) {
+                covered++;
+                break;
             }
         }
 
-        if (cclass == testset[i][0])
-            correct++;
-        confMatrix[cclass][int(testset[i][0])]++;
+    // stage 2: the selected method on the shortlist only
+    QVector<int> nearest;
+    if (ui->jaccardButton->isChecked() || ui->yuleButton->isChecked()) {
+        Metric metric =
+            ui->jaccardButton->isChecked() ? Metric::Jaccard : Metric::Yule;
+        timer.restart();
+        BitMatrix test = packGlyphs(test_images);
+        BitMatrix train = packGlyphs(train_images);
+        runStages << RunStage{"feature extraction", timer.nsecsElapsed()};
+        timer.restart();
+        nearest = rerankBinary(test, all_rows(test.rows), train,
+                               all_rows(train.rows), shortlist, k, metric,
+                               &kernelStats);
+    } else {
+        CleanFeatures();
+        if (ui->projectionsButton->isChecked())
+            extract(&MainWindow::projections);
+        else if (ui->zonesButton->isChecked())
+            extract(&MainWindow::zones);
+        else
+            extract(&MainWindow::subdivisions);
+        timer.restart();
+        nearest = rerankL1(row_pointers(testset), row_pointers(trainset),
+                           trainset.cols, shortlist, k, &kernelStats);
     }
-    return ((double)correct * 100) / testset.size();
+    qint64 stage2 = timer.nsecsElapsed();
+    runStages << RunStage{"cascade extraction", extractNsecs}
+              << RunStage{"cascade stage 1", stage1}
+              << RunStage{"cascade stage 2", stage2};
+
+    int correct = scoreNearest(nearest, train_labels.constData(),
+                               test_labels.constData(), &confusion);
+
+    qint64 pairs = qint64(test_images.size()) * train_images.size();
+    qint64 rescored = qint64(test_images.size()) * qMin(k, train_images.size());
+    runReport << "Cascade stage 1 (" + ui->cascadeComboBox->currentText() +
+                     "): extract " + QString::number(extractNsecs / 1000000) +
+                     " ms, shortlist " + QString::number(stage1 / 1000000) +
+                     " ms [" +
+                     QString::number(coarse.gigaOpsPerSec(), 'f', 2) +
+                     " GFLOP/s], class in shortlist for " +
+                     QString::number(covered * 100.0 / test_images.size(),
+                                     'f', 2) +
+                     "%";
+    runReport << "Cascade stage 2 (" + methodDescription() +
+                     "): " + QString::number(stage2 / 1000000) +
+                     " ms, rescored " + QString::number(rescored) + " of " +
+                     QString::number(pairs) + " pairs (" +
+                     QString::number(rescored * 100.0 / pairs, 'f', 2) + "%)";
+    return ((double)correct * 100) / test_images.size();
 }
@@ -5,11 +5,18 @@
 #include <QFileDialog>
 #include <QMainWindow>
 #include <QMap>
-#include <QTableWidget>
+#include <QTableView>
 #include <QTextStream>
 #include <QTime>
 #include <QVector>
 
+#include "ann.h"
+#include "confusionmatrix.h"
+#include "evaluation.h"
+#include "glyph.h"
+#include "perfcounters.h"
+#include "runhistory.h"
+
 namespace Ui {
 class MainWindow;
 }
@@ -31,43 +38,90 @@ class MainWindow : public QMainWindow {
     void CleanMemory();
     void CleanFeatures();
     void Exit();
+    void showMemoryUsage();
+    QString dataset_hash();
 
-    void Normalize(int, int, QVector<QVector<QVector<int>>> &);
-    void initializeConfussionMatrix(int);
+    void initializeConfussionMatrix();
     void showConfussionMatrix();
     void cleanConfussionMatrix();
     void resetConfussionMatrix();
+    void exportConfussionMatrix();
+    QStringList class_names();
     double jaccard_yule(short);
+    QVector<int> lsh_nearest(const BitMatrix &, const QVector<int> &,
+                             const BitMatrix &, const QVector<int> &, Metric);
     void projections(short);
     void zones(short);
+    int zone_size();
     double classify();
 
+    // per-image feature extractors, writing one feature row
+    void projection_features(const Glyph &, int, double *);
+    void zone_features(const Glyph &, int, double *);
+    void subdivision_features(const Glyph &, int, double *);
+    int feature_count();
+    void extract(void (MainWindow::*)(short));
+    FeatureMatrix &allocate_features(short, int);
+
+    // cascaded (coarse-to-fine) classification
+    void coarse_features(short);
+    double cascade();
+
+    // cross-validation over the whole dataset
+    double classifyFixedSplit();
+    QString methodDescription();
+    void extractFeatures(FeatureMatrix &, const int *);
+    double crossValidate(EvaluationResult &);
+    void showEvaluation(const EvaluationResult &);
+
+    // run history
+    QJsonObject runParameters();
+    void recordRun(double, const EvaluationResult &, qint64);
+    void compareRunHistory();
+
     // recursive subdivisions utils
     void subdivisions(short);
     int find_index(QVector<int>);
-    int find_vertical_point(QVector<QVector<int>>);
-    int find_horizontal_point(QVector<QVector<int>>);
-    void recursive_mock(int, int, int);
-    void recursive_div(QVector<QVector<int>>, int, int, int);
+    int find_vertical_point(const Glyph &);
+    int find_horizontal_point(const Glyph &);
+    void recursive_mock(int, double *&);
+    void recursive_div(const Glyph &, int, double *&);
 
     int maxWidth = -999;
     int maxHeight = -999;
 
-    // raw image values
-    QVector<QVector<QVector<int>>> train_images;
-    QVector<QVector<QVector<int>>> test_images;
+    // owners of the pixel data and the feature rows of the loaded dataset
+    Arena glyphArena{"glyphs"};
+    Arena featureArena{"features"};
+
+    // raw image values and image class
+    QVector<Glyph> train_images;
+    QVector<Glyph> test_images;
+    QVector<int> train_labels;
+    QVector<int> test_labels;
 
-    // image class and features
-    QVector<QVector<double>> trainset;
-    QVector<QVector<double>> testset;
+    // image features
+    FeatureMatrix trainset;
+    FeatureMatrix testset;
 
     // class map (classId -> className)
     QMap<int, QString> class_map;
-    QMap<int, int> class_count_map;
 
     // confussion matrix
-    QTableWidget *uiConfussionMatrix = nullptr;
-    QVector<QVector<int>> confMatrix;
+    ConfusionCounts confusion;
+    ConfusionMatrixModel *confusionModel = nullptr;
+    QTableView *uiConfussionMatrix = nullptr;
+
+    // work done by the distance kernel in the last run
+    KernelStats kernelStats;
+    // extra lines reported after the accuracy of the last run
+    QStringList runReport;
+    // timed stages of the last run, kept in the run history
+    QVector<RunStage> runStages;
+    // measurement-only work of the last run, left out of its latency
+    qint64 untimedNsecs = 0;
+    // identifies the loaded images in the run history
+    QString datasetHash;
 };
 
 #endif // MAINWINDOW_H
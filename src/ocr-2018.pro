@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -26,10 +26,25 @@ CONFIG += c++11
 
 SOURCES += \
         main.cpp \
-        mainwindow.cpp
+        mainwindow.cpp \
+        evaluation.cpp \
+        distance.cpp \
+        arena.cpp \
+        ann.cpp \
+        confusionmatrix.cpp \
+        perfcounters.cpp \
+        runhistory.cpp
 
 HEADERS += \
-        mainwindow.h
+        mainwindow.h \
+        evaluation.h \
+        distance.h \
+        arena.h \
+        glyph.h \
+        ann.h \
+        confusionmatrix.h \
+        perfcounters.h \
+        runhistory.h
 
 FORMS += \
         mainwindow.ui
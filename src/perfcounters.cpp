@@ -0,0 +1,93 @@
+#include "perfcounters.h"
+#include <QStringList>
+
+#ifdef Q_OS_LINUX
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_counter(quint32 type, quint64 config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // this thread, any cpu
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static quint64 l1d_read(quint64 result) {
+    return PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (result << 16);
+}
+#endif
+
+CacheCounters::CacheCounters() {
+    for (int e = 0; e < Events; e++) {
+        fds[e] = -1;
+        counts[e] = 0;
+    }
+#ifdef Q_OS_LINUX
+    fds[L1dLoads] = open_counter(PERF_TYPE_HW_CACHE,
+                                 l1d_read(PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+    fds[L1dMisses] = open_counter(PERF_TYPE_HW_CACHE,
+                                  l1d_read(PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[LlcReferences] =
+        open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    fds[LlcMisses] =
+        open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+}
+
+CacheCounters::~CacheCounters() {
+#ifdef Q_OS_LINUX
+    for (int e = 0; e < Events; e++)
+        if (fds[e] >= 0)
+            close(fds[e]);
+#endif
+}
+
+void CacheCounters::start() {
+#ifdef Q_OS_LINUX
+    for (int e = 0; e < Events; e++)
+        if (fds[e] >= 0) {
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+}
+
+void CacheCounters::stop() {
+#ifdef Q_OS_LINUX
+    for (int e = 0; e < Events; e++)
+        if (fds[e] >= 0) {
+            ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+            quint64 value = 0;
+            if (read(fds[e], &value, sizeof(value)) == sizeof(value))
+                counts[e] += qint64(value);
+        }
+#endif
+}
+
+static QString miss_rate(const QString &cache, qint64 misses,
+                         qint64 accesses) {
+    double rate = accesses ? misses * 100.0 / accesses : 0;
+    return cache + " miss rate " + QString::number(rate, 'f', 2) + "% (" +
+           QString::number(misses) + " / " + QString::number(accesses) + ")";
+}
+
+QString CacheCounters::summary() const {
+    QStringList rates;
+    if (available(L1dLoads) && available(L1dMisses))
+        rates << miss_rate("L1d", counts[L1dMisses], counts[L1dLoads]);
+    if (available(LlcReferences) && available(LlcMisses))
+        rates << miss_rate("LLC", counts[LlcMisses], counts[LlcReferences]);
+    if (rates.isEmpty())
+        return "cache counters unavailable";
+    return rates.join(", ");
+}
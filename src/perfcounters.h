@@ -0,0 +1,33 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QString>
+#include <QtGlobal>
+
+// hardware cache counters of the calling thread (user space only), read
+// through perf_event_open on linux. a counter the kernel refuses (no pmu,
+// perf_event_paranoid, other systems) stays unavailable and counts nothing
+class CacheCounters {
+  public:
+    enum Event { L1dLoads, L1dMisses, LlcReferences, LlcMisses, Events };
+
+    CacheCounters();
+    ~CacheCounters();
+
+    void start();
+    void stop(); // adds the events since start() to the counts
+
+    bool available(Event e) const { return fds[e] >= 0; }
+    qint64 count(Event e) const { return counts[e]; }
+
+    // e.g. "L1d miss rate 1.20% (1200 / 100000), LLC miss rate ..."
+    QString summary() const;
+
+  private:
+    int fds[Events];
+    qint64 counts[Events];
+
+    Q_DISABLE_COPY(CacheCounters)
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,277 @@
+#include "runhistory.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMap>
+#include <QStandardPaths>
+#include <math.h>
+
+// records
+
+QString RunRecord::configuration() const {
+    QString config = method + " [" + evaluation + "]";
+    if (!params.isEmpty())
+        config += " " + QString::fromUtf8(QJsonDocument(params).toJson(
+                            QJsonDocument::Compact));
+    return config + ", threads=" + QString::number(threads) +
+           ", dataset=" + dataset.left(12);
+}
+
+QJsonObject RunRecord::toJson() const {
+    QJsonObject json;
+    json["time"] = time.toString(Qt::ISODate);
+    json["build"] = build;
+    json["dataset"] = dataset;
+    json["method"] = method;
+    json["evaluation"] = evaluation;
+    json["params"] = params;
+    json["threads"] = threads;
+
+    QJsonObject stageTimes;
+    for (const RunStage &stage : stages)
+        stageTimes[stage.name] = double(stage.nsecs);
+    json["stage_nsecs"] = stageTimes;
+    json["total_nsecs"] = double(totalNsecs);
+    json["peak_bytes"] = double(peakBytes);
+
+    json["accuracy"] = accuracy;
+    QJsonArray folds;
+    for (double a : foldAccuracy)
+        folds.append(a);
+    json["fold_accuracy"] = folds;
+    json["classes"] = classes;
+    QJsonArray counts;
+    for (int c : confusion)
+        counts.append(c);
+    json["confusion"] = counts;
+    return json;
+}
+
+RunRecord RunRecord::fromJson(const QJsonObject &json) {
+    RunRecord run;
+    run.time = QDateTime::fromString(json["time"].toString(), Qt::ISODate);
+    run.build = json["build"].toString();
+    run.dataset = json["dataset"].toString();
+    run.method = json["method"].toString();
+    run.evaluation = json["evaluation"].toString();
+    run.params = json["params"].toObject();
+    run.threads = json["threads"].toInt();
+
+    QJsonObject stageTimes = json["stage_nsecs"].toObject();
+    for (auto it = stageTimes.constBegin(); it != stageTimes.constEnd(); ++it)
+        run.stages.push_back({it.key(), qint64(it.value().toDouble())});
+    run.totalNsecs = qint64(json["total_nsecs"].toDouble());
+    run.peakBytes = qint64(json["peak_bytes"].toDouble());
+
+    run.accuracy = json["accuracy"].toDouble();
+    for (const QJsonValue &a : json["fold_accuracy"].toArray())
+        run.foldAccuracy.push_back(a.toDouble());
+    run.classes = json["classes"].toInt();
+    for (const QJsonValue &c : json["confusion"].toArray())
+        run.confusion.push_back(c.toInt());
+    return run;
+}
+
+static QString compute_build_id() {
+    QByteArray id = qgetenv("OCR_BUILD_ID");
+    if (!id.isEmpty())
+        return QString::fromUtf8(id);
+
+    QFile binary(QCoreApplication::applicationFilePath());
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (binary.open(QIODevice::ReadOnly) && hash.addData(&binary))
+        return QString::fromLatin1(hash.result().toHex().left(12));
+    return "unknown";
+}
+
+QString buildId() {
+    // the binary doesn't change while it runs; hash it once
+    static const QString id = compute_build_id();
+    return id;
+}
+
+QString defaultHistoryPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+           "/runs.jsonl";
+}
+
+// history file
+
+bool appendRun(const QString &path, const RunRecord &run) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+    QByteArray line =
+        QJsonDocument(run.toJson()).toJson(QJsonDocument::Compact) + "\n";
+    return file.write(line) == line.size();
+}
+
+QVector<RunRecord> loadRuns(const QString &path) {
+    QVector<RunRecord> runs;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return runs;
+    while (!file.atEnd()) {
+        QJsonDocument doc = QJsonDocument::fromJson(file.readLine());
+        if (doc.isObject())
+            runs.push_back(RunRecord::fromJson(doc.object()));
+    }
+    return runs;
+}
+
+// comparison
+
+// two-sided 95% quantile of student's t with df degrees of freedom
+// (cornish-fisher expansion around the normal quantile, which is too small
+// below 3 degrees of freedom; a fractional df there rounds down, to the
+// larger exact quantile of 1 or 2 degrees of freedom)
+static double t_critical(double df) {
+    static const double exact[] = {12.706, 4.303};
+    if (df < 3)
+        return exact[qMax(int(df), 1) - 1];
+
+    const double z = 1.959964;
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    return z + (z3 + z) / (4 * df) +
+           (5 * z5 + 16 * z3 + 3 * z) / (96 * df * df);
+}
+
+static void mean_variance(const QVector<double> &v, double &mean,
+                          double &var) {
+    mean = 0;
+    for (double x : v)
+        mean += x;
+    mean /= v.size();
+    var = 0;
+    for (double x : v)
+        var += (x - mean) * (x - mean);
+    var = v.size() > 1 ? var / (v.size() - 1) : 0;
+}
+
+SampleComparison compareSamples(const QVector<double> &base,
+                                const QVector<double> &cand,
+                                bool higherIsWorse) {
+    SampleComparison c;
+    c.baseSamples = base.size();
+    c.candSamples = cand.size();
+    if (base.isEmpty() || cand.isEmpty())
+        return c;
+
+    double baseVar, candVar;
+    mean_variance(base, c.baseMean, baseVar);
+    mean_variance(cand, c.candMean, candVar);
+    c.enough = base.size() > 1 && cand.size() > 1;
+    if (!c.enough)
+        return c;
+
+    double seBase = baseVar / base.size();
+    double seCand = candVar / cand.size();
+    double se = seBase + seCand;
+    double diff = c.candMean - c.baseMean;
+
+    if (se == 0) {
+        // deterministic measurements (e.g. accuracy on a fixed split)
+        c.significant = diff != 0;
+        c.t = diff == 0 ? 0 : (diff > 0 ? INFINITY : -INFINITY);
+    } else {
+        c.t = diff / sqrt(se);
+        double df = se * se / (seBase * seBase / (base.size() - 1) +
+                               seCand * seCand / (cand.size() - 1));
+        c.significant = fabs(c.t) > t_critical(df);
+    }
+    c.regression = c.significant && (higherIsWorse ? diff > 0 : diff < 0);
+    return c;
+}
+
+static bool constant(const QVector<double> &v) {
+    for (double x : v)
+        if (x != v[0])
+            return false;
+    return !v.isEmpty();
+}
+
+RunComparison compareRuns(const QVector<RunRecord> &base,
+                          const QVector<RunRecord> &cand) {
+    // reruns of a configuration repeat the same folds, so their fold
+    // accuracies are not independent samples; each run counts once
+    QVector<double> baseMs, candMs, baseAcc, candAcc;
+    for (const RunRecord &run : base) {
+        baseMs << run.totalNsecs / 1e6;
+        baseAcc << run.accuracy;
+    }
+    for (const RunRecord &run : cand) {
+        candMs << run.totalNsecs / 1e6;
+        candAcc << run.accuracy;
+    }
+
+    RunComparison c;
+    if (!base.isEmpty())
+        c.configuration = base[0].configuration();
+    c.latency = compareSamples(baseMs, candMs, true);
+    c.accuracy = compareSamples(baseAcc, candAcc, false);
+    if (constant(baseAcc) && constant(candAcc)) {
+        c.accuracy.exact = true;
+        c.accuracy.enough = true;
+        c.accuracy.t = 0;
+        c.accuracy.significant = c.accuracy.candMean != c.accuracy.baseMean;
+        c.accuracy.regression = c.accuracy.candMean < c.accuracy.baseMean;
+    }
+    return c;
+}
+
+QVector<RunComparison> compareBuilds(const QVector<RunRecord> &runs,
+                                     const QString &base,
+                                     const QString &cand) {
+    QMap<QString, QVector<RunRecord>> baseRuns, candRuns;
+    for (const RunRecord &run : runs) {
+        if (run.build == base)
+            baseRuns[run.configuration()].push_back(run);
+        else if (run.build == cand)
+            candRuns[run.configuration()].push_back(run);
+    }
+
+    QVector<RunComparison> comparisons;
+    for (auto it = baseRuns.constBegin(); it != baseRuns.constEnd(); ++it)
+        if (candRuns.contains(it.key()))
+            comparisons.push_back(compareRuns(it.value(), candRuns[it.key()]));
+    return comparisons;
+}
+
+static QString describe(const QString &what, const SampleComparison &c,
+                        const QString &unit) {
+    QString line = what + ": " + QString::number(c.baseMean, 'f', 2) + unit +
+                   " (n=" + QString::number(c.baseSamples) + ") -> " +
+                   QString::number(c.candMean, 'f', 2) + unit +
+                   " (n=" + QString::number(c.candSamples) + ")";
+    if (c.baseMean != 0)
+        line += ", " +
+                QString::number((c.candMean - c.baseMean) * 100 / c.baseMean,
+                                'f', 1) +
+                "%";
+    if (c.exact) {
+        if (c.regression)
+            return line + " REGRESSION";
+        return line + (c.significant ? " (improved)" : " (unchanged)");
+    }
+    if (!c.enough)
+        return line + ", too few samples to test";
+    line += ", t = " + QString::number(c.t, 'f', 2);
+    if (c.regression)
+        return line + " REGRESSION";
+    return line + (c.significant ? " (significant improvement)"
+                                 : " (no significant change)");
+}
+
+QStringList RunComparison::report() const {
+    QStringList lines;
+    lines << configuration;
+    lines << "  " + describe("latency", latency, " ms");
+    lines << "  " + describe("accuracy", accuracy, "%");
+    return lines;
+}
@@ -0,0 +1,89 @@
+#ifndef RUNHISTORY_H
+#define RUNHISTORY_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// wall time of one stage of a run (feature extraction, distance kernel, ..)
+struct RunStage {
+    QString name;
+    qint64 nsecs;
+};
+
+// everything recorded about one classification run; the history is a file
+// with one json object per line, appended to after every run
+struct RunRecord {
+    QDateTime time;
+    QString build;      // see buildId()
+    QString dataset;    // hash of the loaded pixels and labels
+    QString method;     // e.g. "5 projections"
+    QString evaluation; // e.g. "10-fold"
+    QJsonObject params; // options of the method (lsh, cascade)
+    int threads = 0;
+    QVector<RunStage> stages;
+    qint64 totalNsecs = 0;
+    qint64 peakBytes = 0;
+    double accuracy = 0;
+    QVector<double> foldAccuracy; // cross-validation only
+    int classes = 0;
+    QVector<int> confusion; // [predicted * classes + actual]
+
+    // runs of the same configuration are samples of the same measurement
+    QString configuration() const;
+
+    QJsonObject toJson() const;
+    static RunRecord fromJson(const QJsonObject &json);
+};
+
+// identifies the running binary: $OCR_BUILD_ID when set (e.g. a git
+// revision), otherwise a hash of the executable
+QString buildId();
+QString defaultHistoryPath();
+
+bool appendRun(const QString &path, const RunRecord &run);
+QVector<RunRecord> loadRuns(const QString &path); // skips malformed lines
+
+// welch's t-test between the samples of two groups of runs, two-sided at
+// the 5% level; a regression is a significant change for the worse
+struct SampleComparison {
+    int baseSamples = 0;
+    int candSamples = 0;
+    double baseMean = 0;
+    double candMean = 0;
+    double t = 0;
+    bool enough = false; // at least two samples on each side
+    bool significant = false;
+    bool regression = false;
+    bool exact = false; // both groups constant, compared without a test
+};
+
+SampleComparison compareSamples(const QVector<double> &base,
+                                const QVector<double> &cand,
+                                bool higherIsWorse);
+
+// one sample per run: its total time and its (mean) accuracy. accuracy is
+// deterministic for a configuration, so when each group agrees on one
+// value any difference is reported as a change without testing it
+struct RunComparison {
+    QString configuration;
+    SampleComparison latency; // ms
+    SampleComparison accuracy;
+
+    bool regression() const {
+        return latency.regression || accuracy.regression;
+    }
+    QStringList report() const;
+};
+
+RunComparison compareRuns(const QVector<RunRecord> &base,
+                          const QVector<RunRecord> &cand);
+
+// compares every configuration run by both builds
+QVector<RunComparison> compareBuilds(const QVector<RunRecord> &runs,
+                                     const QString &base,
+                                     const QString &cand);
+
+#endif // RUNHISTORY_H